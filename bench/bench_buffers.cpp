@@ -0,0 +1,252 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Throughput and memory benchmarks for the temporal filtering buffers.
+ *
+ * Every buffer is measured with all element types, frame sizes and window
+ * sizes. Push and read are timed separately; besides the time per iteration
+ * the following counters are reported:
+ *
+ *   time_per_pixel : time per iteration divided by the number of pixels
+ *   bytes_per_iter : heap memory allocated inside the timed loop
+ *   footprint      : heap memory allocated when constructing the buffer
+ *
+ * Use --benchmark_format=json (or --benchmark_out=<file>) to get results in
+ * machine-readable form, and --benchmark_filter=<regex> to select a subset,
+ * e.g. --benchmark_filter='Median.*unsigned short.*width:640'. */
+
+#include <benchmark/benchmark.h>
+
+#include <new>
+#include <cstdlib>
+#include <algorithm>
+
+#include "buffers.h"
+
+using namespace pcl::io;
+
+/* Global allocation counters. Bytes are counted when allocated and never
+ * decremented, so differences give the amount of memory requested by the
+ * code in between. */
+static size_t num_allocations = 0;
+static size_t num_allocated_bytes = 0;
+
+/* The replacements must not be inlined, otherwise GCC sees malloc () paired
+ * with operator delete (or operator new with free ()) and warns about the
+ * mismatch. */
+#if defined (__GNUC__)
+#define NOINLINE __attribute__ ((noinline))
+#elif defined (_MSC_VER)
+#define NOINLINE __declspec (noinline)
+#else
+#define NOINLINE
+#endif
+
+NOINLINE void* operator new (size_t size)
+{
+  ++num_allocations;
+  num_allocated_bytes += size;
+  void* ptr = malloc (size);
+  if (!ptr)
+    throw std::bad_alloc ();
+  return (ptr);
+}
+
+NOINLINE void operator delete (void* ptr) throw ()
+{
+  free (ptr);
+}
+
+/* Compilers with sized deallocation call this one instead. */
+NOINLINE void operator delete (void* ptr, size_t) throw ()
+{
+  free (ptr);
+}
+
+/* Buffer construction, specialized for every buffer type. Window size has
+ * the same meaning as in RealSenseGrabber::enableTemporalFiltering(). */
+template <template <typename> class BufferT>
+struct BufferFactory;
+
+template <>
+struct BufferFactory<SingleBuffer>
+{
+  template <typename T> static Buffer<T>*
+  create (size_t size, size_t) { return (new SingleBuffer<T> (size)); }
+};
+
+template <>
+struct BufferFactory<MedianBuffer>
+{
+  template <typename T> static Buffer<T>*
+  create (size_t size, size_t window) { return (new MedianBuffer<T> (size, window)); }
+};
+
+template <>
+struct BufferFactory<AverageBuffer>
+{
+  template <typename T> static Buffer<T>*
+  create (size_t size, size_t window) { return (new AverageBuffer<T> (size, window)); }
+};
+
+template <>
+struct BufferFactory<ExponentialBuffer>
+{
+  template <typename T> static Buffer<T>*
+  create (size_t size, size_t window) { return (new ExponentialBuffer<T> (size, 2.0f / (window + 1))); }
+};
+
+template <>
+struct BufferFactory<AdaptiveBuffer>
+{
+  template <typename T> static Buffer<T>*
+  create (size_t size, size_t window) { return (new AdaptiveBuffer<T> (size, window, 20.0f)); }
+};
+
+/* Generate a sequence of frames that simulate a static scene: every pixel is
+ * a noisy measurement of a fixed value, with some invalid pixels. Values are
+ * kept well within the range of T. */
+template <typename T> static std::vector<std::vector<T> >
+generateFrames (size_t width, size_t height, size_t num_frames)
+{
+  const size_t size = width * height;
+  const size_t range = std::min<size_t> (1000, static_cast<size_t> (std::numeric_limits<T>::max ()) - 32);
+  srand (42);
+  std::vector<std::vector<T> > frames (num_frames, std::vector<T> (size));
+  for (size_t f = 0; f < num_frames; ++f)
+    for (size_t i = 0; i < size; ++i)
+      frames[f][i] = rand () % 20 == 0 ? buffer_traits<T>::invalid ()
+                                       : static_cast<T> (1 + (i % width) % range + rand () % 16);
+  return (frames);
+}
+
+static const size_t NUM_FRAMES = 8;
+
+template <template <typename> class BufferT, typename T> static void
+BM_Push (benchmark::State& state)
+{
+  const size_t width = state.range (0);
+  const size_t height = state.range (1);
+  const size_t window = state.range (2);
+  std::vector<std::vector<T> > frames = generateFrames<T> (width, height, NUM_FRAMES);
+  size_t bytes_before = num_allocated_bytes;
+  boost::shared_ptr<Buffer<T> > buffer (BufferFactory<BufferT>::template create<T> (width * height, window));
+  const size_t footprint = num_allocated_bytes - bytes_before;
+  // Fill the window before measuring
+  for (size_t i = 0; i < window; ++i)
+    buffer->push (frames[i % NUM_FRAMES].data ());
+  size_t i = 0;
+  bytes_before = num_allocated_bytes;
+  for (auto _ : state)
+  {
+    buffer->push (frames[i++ % NUM_FRAMES].data ());
+    benchmark::ClobberMemory ();
+  }
+  const size_t bytes = num_allocated_bytes - bytes_before;
+  state.counters["time_per_pixel"] = benchmark::Counter (width * height, benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+  state.counters["bytes_per_iter"] = benchmark::Counter (bytes, benchmark::Counter::kAvgIterations);
+  state.counters["footprint"] = footprint;
+}
+
+template <template <typename> class BufferT, typename T> static void
+BM_Read (benchmark::State& state)
+{
+  const size_t width = state.range (0);
+  const size_t height = state.range (1);
+  const size_t window = state.range (2);
+  std::vector<std::vector<T> > frames = generateFrames<T> (width, height, NUM_FRAMES);
+  std::vector<T> out (width * height);
+  size_t bytes_before = num_allocated_bytes;
+  boost::shared_ptr<Buffer<T> > buffer (BufferFactory<BufferT>::template create<T> (width * height, window));
+  const size_t footprint = num_allocated_bytes - bytes_before;
+  for (size_t i = 0; i < window; ++i)
+    buffer->push (frames[i % NUM_FRAMES].data ());
+  bytes_before = num_allocated_bytes;
+  for (auto _ : state)
+  {
+    buffer->copyTo (out.data ());
+    benchmark::DoNotOptimize (out.data ());
+    benchmark::ClobberMemory ();
+  }
+  const size_t bytes = num_allocated_bytes - bytes_before;
+  state.counters["time_per_pixel"] = benchmark::Counter (width * height, benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+  state.counters["bytes_per_iter"] = benchmark::Counter (bytes, benchmark::Counter::kAvgIterations);
+  state.counters["footprint"] = footprint;
+}
+
+/* QVGA, VGA and 1080p frames, with window sizes that cover the range used by
+ * RealSenseGrabber. */
+static void
+WindowedArgs (benchmark::internal::Benchmark* b)
+{
+  const int sizes[][2] = { { 320, 240 }, { 640, 480 }, { 1920, 1080 } };
+  const int windows[] = { 3, 9, 30 };
+  b->ArgNames ({ "width", "height", "window" });
+  for (size_t s = 0; s < 3; ++s)
+    for (size_t w = 0; w < 3; ++w)
+      b->Args ({ sizes[s][0], sizes[s][1], windows[w] });
+  b->Unit (benchmark::kMicrosecond);
+}
+
+/* Same frame sizes, for the buffers that do not keep a window. */
+static void
+SingleArgs (benchmark::internal::Benchmark* b)
+{
+  const int sizes[][2] = { { 320, 240 }, { 640, 480 }, { 1920, 1080 } };
+  b->ArgNames ({ "width", "height", "window" });
+  for (size_t s = 0; s < 3; ++s)
+    b->Args ({ sizes[s][0], sizes[s][1], 1 });
+  b->Unit (benchmark::kMicrosecond);
+}
+
+#define BENCH_BUFFER(BufferT, T, Args)                      \
+  BENCHMARK_TEMPLATE2 (BM_Push, BufferT, T)->Apply (Args);  \
+  BENCHMARK_TEMPLATE2 (BM_Read, BufferT, T)->Apply (Args);
+
+#define BENCH_BUFFER_ALL_TYPES(BufferT, Args)               \
+  BENCH_BUFFER (BufferT, char, Args)                        \
+  BENCH_BUFFER (BufferT, int, Args)                         \
+  BENCH_BUFFER (BufferT, float, Args)                       \
+  BENCH_BUFFER (BufferT, unsigned short, Args)
+
+BENCH_BUFFER_ALL_TYPES (SingleBuffer, SingleArgs)
+BENCH_BUFFER_ALL_TYPES (MedianBuffer, WindowedArgs)
+BENCH_BUFFER_ALL_TYPES (AverageBuffer, WindowedArgs)
+BENCH_BUFFER_ALL_TYPES (ExponentialBuffer, WindowedArgs)
+BENCH_BUFFER_ALL_TYPES (AdaptiveBuffer, WindowedArgs)
+
+BENCHMARK_MAIN ();
@@ -0,0 +1,129 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Measures decimation of a VGA depth frame and how it changes the cost of
+ * the whole depth pipeline (decimation, temporal median filtering over 5
+ * frames, projection into an XYZ cloud). */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+
+#include "buffers.h"
+#include "real_sense/decimation.h"
+
+using namespace pcl::io;
+using namespace pcl::io::real_sense;
+
+/* Stand-in for pcl::PointXYZ with the same padded layout. */
+struct alignas (16) Point
+{
+  float data[4];
+};
+
+static const unsigned int WIDTH = 640;
+static const unsigned int HEIGHT = 480;
+static const unsigned int SIZE = WIDTH * HEIGHT;
+
+static std::vector<unsigned short>
+generateFrame ()
+{
+  srand (42);
+  std::vector<unsigned short> frame (SIZE);
+  for (size_t i = 0; i < SIZE; ++i)
+    frame[i] = rand () % 20 == 0 ? 0 : 500 + (i % WIDTH) + rand () % 16;
+  return (frame);
+}
+
+static void
+BM_Decimate (benchmark::State& state)
+{
+  const unsigned int factor = state.range (0);
+  const DecimationMethod method = static_cast<DecimationMethod> (state.range (1));
+  std::vector<unsigned short> frame = generateFrame ();
+  std::vector<unsigned short> out ((WIDTH / factor) * (HEIGHT / factor));
+  for (auto _ : state)
+  {
+    decimateDepth (frame.data (), WIDTH, HEIGHT, factor, method, out.data ());
+    benchmark::DoNotOptimize (out.data ());
+  }
+  state.SetItemsProcessed (state.iterations () * SIZE);
+}
+
+static void
+BM_Pipeline (benchmark::State& state)
+{
+  const unsigned int factor = state.range (0);
+  const DecimationMethod method = static_cast<DecimationMethod> (state.range (1));
+  const unsigned int width = WIDTH / factor;
+  const unsigned int height = HEIGHT / factor;
+  const CameraIntrinsics intrinsics (475.0f, 475.0f, 310.5f, 245.5f);
+  RayTable table (width, height, decimateIntrinsics (intrinsics, factor, method));
+  FixedMedianBuffer<unsigned short, 5> buffer (width * height);
+  std::vector<unsigned short> frame = generateFrame ();
+  std::vector<unsigned short> decimated (width * height);
+  std::vector<Point> points (width * height);
+  for (auto _ : state)
+  {
+    const unsigned short* depth = frame.data ();
+    if (factor > 1)
+    {
+      decimateDepth (frame.data (), WIDTH, HEIGHT, factor, method, decimated.data ());
+      depth = decimated.data ();
+    }
+    buffer.push (depth);
+    buffer.copyTo (decimated.data ());
+    table.project (decimated.data (), points.data ());
+    benchmark::DoNotOptimize (points.data ());
+  }
+  state.SetItemsProcessed (state.iterations () * SIZE);
+}
+
+BENCHMARK (BM_Decimate)
+  ->Args ({2, DECIMATION_STRIDE})->Args ({4, DECIMATION_STRIDE})
+  ->Args ({2, DECIMATION_MEDIAN})->Args ({4, DECIMATION_MEDIAN})
+  ->Args ({2, DECIMATION_MEAN})->Args ({4, DECIMATION_MEAN})
+  ->Unit (benchmark::kMicrosecond);
+
+BENCHMARK (BM_Pipeline)
+  ->Args ({1, DECIMATION_STRIDE})
+  ->Args ({2, DECIMATION_STRIDE})->Args ({4, DECIMATION_STRIDE})
+  ->Args ({2, DECIMATION_MEDIAN})->Args ({4, DECIMATION_MEDIAN})
+  ->Args ({2, DECIMATION_MEAN})->Args ({4, DECIMATION_MEAN})
+  ->Unit (benchmark::kMicrosecond);
+
+BENCHMARK_MAIN ();
@@ -0,0 +1,98 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+
+#include "buffers.h"
+
+using namespace pcl::io;
+
+static const size_t WIDTH = 640;
+static const size_t HEIGHT = 480;
+static const size_t SIZE = WIDTH * HEIGHT;
+
+/* Generate a sequence of depth frames that simulate a static scene: every
+ * pixel is a noisy measurement of a fixed depth, with some invalid pixels. */
+static std::vector<std::vector<unsigned short> >
+generateFrames (size_t num_frames)
+{
+  srand (42);
+  std::vector<std::vector<unsigned short> > frames (num_frames, std::vector<unsigned short> (SIZE));
+  for (size_t f = 0; f < num_frames; ++f)
+    for (size_t i = 0; i < SIZE; ++i)
+      frames[f][i] = rand () % 20 == 0 ? 0 : 500 + (i % WIDTH) + rand () % 16;
+  return (frames);
+}
+
+template <typename BufferT> static void
+benchmarkBuffer (benchmark::State& state, BufferT& buffer)
+{
+  std::vector<std::vector<unsigned short> > frames = generateFrames (16);
+  std::vector<unsigned short> out (SIZE);
+  // Fill the window before measuring
+  for (size_t i = 0; i < static_cast<size_t> (state.range (0)); ++i)
+    buffer.push (frames[i % frames.size ()].data ());
+  size_t i = 0;
+  for (auto _ : state)
+  {
+    buffer.push (frames[i++ % frames.size ()].data ());
+    buffer.copyTo (out.data ());
+    benchmark::DoNotOptimize (out.data ());
+  }
+  state.SetItemsProcessed (state.iterations () * SIZE);
+}
+
+static void
+BM_MedianBuffer (benchmark::State& state)
+{
+  MedianBuffer<unsigned short> buffer (SIZE, state.range (0));
+  benchmarkBuffer (state, buffer);
+}
+
+static void
+BM_HistogramMedianBuffer (benchmark::State& state)
+{
+  HistogramMedianBuffer buffer (SIZE, state.range (0));
+  benchmarkBuffer (state, buffer);
+}
+
+BENCHMARK (BM_MedianBuffer)->Arg (5)->Arg (15)->Arg (31)->Arg (63)->Arg (100)->Arg (255)->Unit (benchmark::kMillisecond);
+BENCHMARK (BM_HistogramMedianBuffer)->Arg (5)->Arg (15)->Arg (31)->Arg (63)->Arg (100)->Arg (255)->Unit (benchmark::kMillisecond);
+
+BENCHMARK_MAIN ();
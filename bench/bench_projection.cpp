@@ -0,0 +1,125 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Compares the conversion of a depth frame and a registered color frame into
+ * XYZ and XYZRGBA clouds done in three passes (project XYZ, copy XYZ into
+ * XYZRGBA as pcl::copyPointCloud does, copy colors) with the fused
+ * single-pass kernel. */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <cstring>
+
+#include "real_sense/ray_table.h"
+
+using namespace pcl::io::real_sense;
+
+/* Stand-ins for PCL points with the same padded layout. */
+struct alignas (16) Point
+{
+  float data[4];
+};
+
+struct alignas (16) ColoredPoint
+{
+  float data[4];
+  boost::uint32_t rgba;
+  float padding[3];
+};
+
+static const size_t WIDTH = 640;
+static const size_t HEIGHT = 480;
+static const size_t SIZE = WIDTH * HEIGHT;
+
+class ProjectionFixture : public benchmark::Fixture
+{
+
+  public:
+
+    ProjectionFixture ()
+    : table (WIDTH, HEIGHT, CameraIntrinsics (475.0f, 475.0f, 310.5f, 245.5f))
+    , depth (SIZE)
+    , color (SIZE)
+    , points (SIZE)
+    , colored_points (SIZE)
+    {
+      srand (42);
+      for (size_t i = 0; i < SIZE; ++i)
+      {
+        depth[i] = rand () % 20 == 0 ? 0 : 500 + rand () % 1000;
+        color[i] = rand ();
+      }
+    }
+
+    RayTable table;
+    std::vector<unsigned short> depth;
+    std::vector<boost::uint32_t> color;
+    std::vector<Point> points;
+    std::vector<ColoredPoint> colored_points;
+
+};
+
+BENCHMARK_DEFINE_F (ProjectionFixture, Separate) (benchmark::State& state)
+{
+  for (auto _ : state)
+  {
+    table.project (depth.data (), points.data ());
+    for (size_t i = 0; i < SIZE; ++i)
+      for (size_t k = 0; k < 4; ++k)
+        colored_points[i].data[k] = points[i].data[k];
+    for (size_t i = 0; i < SIZE; ++i)
+      memcpy (&colored_points[i].rgba, &color[i], sizeof (boost::uint32_t));
+    benchmark::ClobberMemory ();
+  }
+  state.SetBytesProcessed (state.iterations () * SIZE * (sizeof (Point) + sizeof (ColoredPoint)));
+}
+
+BENCHMARK_DEFINE_F (ProjectionFixture, Fused) (benchmark::State& state)
+{
+  for (auto _ : state)
+  {
+    table.project (depth.data (), color.data (), points.data (), colored_points.data ());
+    benchmark::ClobberMemory ();
+  }
+  state.SetBytesProcessed (state.iterations () * SIZE * (sizeof (Point) + sizeof (ColoredPoint)));
+}
+
+BENCHMARK_REGISTER_F (ProjectionFixture, Separate)->Unit (benchmark::kMicrosecond);
+BENCHMARK_REGISTER_F (ProjectionFixture, Fused)->Unit (benchmark::kMicrosecond);
+
+BENCHMARK_MAIN ();
@@ -0,0 +1,106 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Measures the per-call overhead of the clocks and timers in
+ * real_sense/time.h and of trace scopes, compared to the wall clock that
+ * MyStopWatch used before. */
+
+#include <benchmark/benchmark.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "real_sense/time.h"
+#include "real_sense/trace.h"
+
+using namespace pcl::io::real_sense;
+
+static void
+BM_PosixLocalTime (benchmark::State& state)
+{
+  for (auto _ : state)
+    benchmark::DoNotOptimize (boost::posix_time::microsec_clock::local_time ());
+}
+BENCHMARK (BM_PosixLocalTime);
+
+static void
+BM_MonotonicTime (benchmark::State& state)
+{
+  for (auto _ : state)
+    benchmark::DoNotOptimize (getMonotonicTimeNs ());
+}
+BENCHMARK (BM_MonotonicTime);
+
+static void
+BM_StopWatch (benchmark::State& state)
+{
+  pcl::MyStopWatch watch;
+  for (auto _ : state)
+    benchmark::DoNotOptimize (watch.getTimeNanoSeconds ());
+}
+BENCHMARK (BM_StopWatch);
+
+/* Cost of an empty timed scope, i.e. two clock reads and a record. */
+static void
+BM_ScopeTime (benchmark::State& state)
+{
+  for (auto _ : state)
+    pcl::MyScopeTime timer ("scope");
+}
+BENCHMARK (BM_ScopeTime)->ThreadRange (1, 4);
+
+/* Cost of a trace scope while tracing is disabled, which is what hot paths
+ * pay in production. */
+static void
+BM_TraceScopeDisabled (benchmark::State& state)
+{
+  setTracingEnabled (false);
+  for (auto _ : state)
+    PCL_REAL_SENSE_TRACE_SCOPE ("scope");
+}
+BENCHMARK (BM_TraceScopeDisabled);
+
+static void
+BM_TraceScopeEnabled (benchmark::State& state)
+{
+  setTracingEnabled (true);
+  for (auto _ : state)
+    PCL_REAL_SENSE_TRACE_SCOPE ("scope");
+  setTracingEnabled (false);
+}
+BENCHMARK (BM_TraceScopeEnabled);
+
+BENCHMARK_MAIN ();
@@ -0,0 +1,198 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef PCL_IO_ASYNC_SLOT_H
+#define PCL_IO_ASYNC_SLOT_H
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/utility.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace pcl
+{
+
+  namespace io
+  {
+
+    /** A callback that runs on its own worker thread and only ever sees the
+      * latest item.
+      *
+      * post() puts an item into a single-slot mailbox and returns
+      * immediately. If the worker is still busy with a previous item when a
+      * new one arrives, the item waiting in the mailbox is replaced (and
+      * counted as skipped), so a slow callback falls behind by at most one
+      * item and never delays the producer. */
+    template <typename T>
+    class AsyncSlot : boost::noncopyable
+    {
+
+      public:
+
+        typedef boost::shared_ptr<AsyncSlot<T> > Ptr;
+        typedef boost::function<void (const T&)> Callback;
+
+        AsyncSlot (const Callback& callback)
+        : callback_ (callback)
+        , pending_ ()
+        , has_pending_ (false)
+        , stop_ (false)
+        , num_delivered_ (0)
+        , num_skipped_ (0)
+        {
+          thread_ = boost::thread (boost::bind (&AsyncSlot::work, this));
+        }
+
+        ~AsyncSlot ()
+        {
+          stop ();
+        }
+
+        /** Hand an item over to the worker, replacing the one that is waiting
+          * in the mailbox (if any). */
+        void
+        post (const T& item)
+        {
+          // Replaced item is destroyed outside of the lock
+          T replaced (item);
+          {
+            boost::mutex::scoped_lock lock (mutex_);
+            if (stop_)
+            {
+              ++num_skipped_;
+              return;
+            }
+            if (has_pending_)
+              ++num_skipped_;
+            std::swap (pending_, replaced);
+            has_pending_ = true;
+          }
+          item_available_.notify_one ();
+        }
+
+        /** Stop the worker.
+          *
+          * Waits until the callback returns if it is running, the item
+          * waiting in the mailbox is discarded (and counted as skipped).
+          * Subsequent post() calls have no effect. Should not be called (nor
+          * the slot destroyed) from within the callback. */
+        void
+        stop ()
+        {
+          T discarded = T ();
+          {
+            boost::mutex::scoped_lock lock (mutex_);
+            if (stop_)
+              return;
+            stop_ = true;
+            if (has_pending_)
+              ++num_skipped_;
+            std::swap (pending_, discarded);
+            has_pending_ = false;
+          }
+          item_available_.notify_one ();
+          thread_.join ();
+        }
+
+        /** Get the number of items passed to the callback. */
+        size_t
+        getNumDelivered () const
+        {
+          boost::mutex::scoped_lock lock (mutex_);
+          return (num_delivered_);
+        }
+
+        /** Get the number of items that were replaced or discarded before the
+          * callback could take them. */
+        size_t
+        getNumSkipped () const
+        {
+          boost::mutex::scoped_lock lock (mutex_);
+          return (num_skipped_);
+        }
+
+      private:
+
+        void
+        work ()
+        {
+          boost::mutex::scoped_lock lock (mutex_);
+          while (true)
+          {
+            while (!stop_ && !has_pending_)
+              item_available_.wait (lock);
+            if (stop_)
+              return;
+            T item = T ();
+            std::swap (item, pending_);
+            has_pending_ = false;
+            ++num_delivered_;
+            lock.unlock ();
+            callback_ (item);
+            item = T ();
+            lock.lock ();
+          }
+        }
+
+        Callback callback_;
+
+        /// Protects the mailbox, the counters and the stop flag
+        mutable boost::mutex mutex_;
+        boost::condition_variable item_available_;
+
+        T pending_;
+        bool has_pending_;
+        bool stop_;
+
+        size_t num_delivered_;
+        size_t num_skipped_;
+
+        boost::thread thread_;
+
+    };
+
+  }
+
+}
+
+#endif /* PCL_IO_ASYNC_SLOT_H */
+
@@ -0,0 +1,212 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef PCL_IO_BOUNDED_QUEUE_H
+#define PCL_IO_BOUNDED_QUEUE_H
+
+#include <algorithm>
+
+#include <boost/utility.hpp>
+#include <boost/circular_buffer.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace pcl
+{
+
+  namespace io
+  {
+
+    /** What BoundedQueue::push() does when the queue is full. */
+    enum OverflowPolicy
+    {
+      /// Discard the oldest item in the queue to make room for the new one
+      DROP_OLDEST = 0,
+      /// Discard the new item
+      DROP_NEWEST = 1,
+      /// Wait until a consumer makes room
+      BLOCK = 2,
+    };
+
+    /** A fixed-capacity multi-producer multi-consumer FIFO queue.
+      *
+      * Storage is allocated once on construction. When the queue is full,
+      * push() follows the overflow policy, and the number of discarded items
+      * is counted. Closing the queue wakes up all threads that wait in push()
+      * or pop(). */
+    template <typename T>
+    class BoundedQueue : boost::noncopyable
+    {
+
+      public:
+
+        BoundedQueue (size_t capacity, OverflowPolicy policy)
+        : items_ (std::max<size_t> (capacity, 1))
+        , policy_ (policy)
+        , closed_ (false)
+        , num_pushed_ (0)
+        , num_dropped_ (0)
+        {
+        }
+
+        /** Add an item to the queue.
+          *
+          * \return false if the item was not added, either because the queue
+          * is full and the policy is DROP_NEWEST, or because the queue was
+          * closed */
+        bool
+        push (const T& item)
+        {
+          T dropped;
+          {
+            boost::mutex::scoped_lock lock (mutex_);
+            if (policy_ == BLOCK)
+              while (!closed_ && items_.full ())
+                not_full_.wait (lock);
+            if (closed_)
+              return (false);
+            ++num_pushed_;
+            if (items_.full ())
+            {
+              ++num_dropped_;
+              if (policy_ == DROP_NEWEST)
+                return (false);
+              // Destroy the oldest item outside of the lock
+              std::swap (dropped, items_.front ());
+              items_.pop_front ();
+            }
+            items_.push_back (item);
+          }
+          not_empty_.notify_one ();
+          return (true);
+        }
+
+        /** Take the oldest item from the queue, waiting until there is one.
+          *
+          * \return false if the queue was closed */
+        bool
+        pop (T& item)
+        {
+          {
+            boost::mutex::scoped_lock lock (mutex_);
+            while (!closed_ && items_.empty ())
+              not_empty_.wait (lock);
+            if (closed_)
+              return (false);
+            item = items_.front ();
+            items_.pop_front ();
+          }
+          not_full_.notify_one ();
+          return (true);
+        }
+
+        /** Close the queue and discard its items.
+          *
+          * Subsequent and pending push() and pop() calls return false. */
+        void
+        close ()
+        {
+          // Items are destroyed outside of the lock
+          boost::circular_buffer<T> items;
+          {
+            boost::mutex::scoped_lock lock (mutex_);
+            closed_ = true;
+            items.swap (items_);
+            items_.set_capacity (items.capacity ());
+          }
+          not_empty_.notify_all ();
+          not_full_.notify_all ();
+        }
+
+        size_t
+        size () const
+        {
+          boost::mutex::scoped_lock lock (mutex_);
+          return (items_.size ());
+        }
+
+        size_t
+        getCapacity () const
+        {
+          boost::mutex::scoped_lock lock (mutex_);
+          return (items_.capacity ());
+        }
+
+        OverflowPolicy
+        getPolicy () const
+        {
+          return (policy_);
+        }
+
+        /** Get the number of items passed to push() while the queue was open,
+          * including the ones that were dropped. */
+        size_t
+        getNumPushed () const
+        {
+          boost::mutex::scoped_lock lock (mutex_);
+          return (num_pushed_);
+        }
+
+        /** Get the number of items dropped because the queue was full. */
+        size_t
+        getNumDropped () const
+        {
+          boost::mutex::scoped_lock lock (mutex_);
+          return (num_dropped_);
+        }
+
+      private:
+
+        boost::circular_buffer<T> items_;
+        const OverflowPolicy policy_;
+        bool closed_;
+
+        size_t num_pushed_;
+        size_t num_dropped_;
+
+        mutable boost::mutex mutex_;
+        boost::condition_variable not_empty_;
+        boost::condition_variable not_full_;
+
+    };
+
+  }
+
+}
+
+#endif /* PCL_IO_BOUNDED_QUEUE_H */
+
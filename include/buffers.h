@@ -43,6 +43,9 @@
 #include <cassert>
 
 #include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "thread_pool.h"
 
 namespace pcl
 {
@@ -50,6 +53,52 @@ namespace pcl
   namespace io
   {
 
+    /** Type used to accumulate sums of buffer elements.
+      *
+      * It is wide enough to hold the sum of 255 (the maximum window size)
+      * elements without overflow or loss of precision. */
+    template <typename T>
+    struct accumulator_traits
+    {
+      typedef T type;
+    };
+
+    template <>
+    struct accumulator_traits<char>
+    {
+      typedef boost::int32_t type;
+    };
+
+    template <>
+    struct accumulator_traits<unsigned char>
+    {
+      typedef boost::uint32_t type;
+    };
+
+    template <>
+    struct accumulator_traits<short>
+    {
+      typedef boost::int32_t type;
+    };
+
+    template <>
+    struct accumulator_traits<unsigned short>
+    {
+      typedef boost::uint32_t type;
+    };
+
+    template <>
+    struct accumulator_traits<int>
+    {
+      typedef boost::int64_t type;
+    };
+
+    template <>
+    struct accumulator_traits<float>
+    {
+      typedef double type;
+    };
+
     template <typename T>
     class Buffer
     {
@@ -64,21 +113,86 @@ namespace pcl
         virtual T
         operator[] (size_t idx) const = 0;
 
+        /** Copy a range of elements from the buffer.
+          *
+          * This is equivalent to calling operator[] for every index in the
+          * range, but avoids a virtual call per element.
+          *
+          * \param[out] out pointer to the memory where elements with indices
+          * [\a begin, \a end) will be written (must hold \a end - \a begin
+          * elements)
+          * \param[in] begin index of the first element to copy
+          * \param[in] end index past the last element to copy */
+        virtual void
+        read (T* out, size_t begin, size_t end) const = 0;
+
+        /** Copy all elements from the buffer.
+          *
+          * \param[out] out pointer to the memory where the elements will be
+          * written (must hold size() elements) */
+        inline void
+        copyTo (T* out) const
+        {
+          read (out, 0, size_);
+        }
+
+        /** Push a new data chunk into the buffer.
+          *
+          * The contents of \a data are consumed and the vector is left empty. */
         virtual void
         push (std::vector<T>& data) = 0;
 
+        /** Push a new data chunk into the buffer.
+          *
+          * The data is copied into storage already owned by the buffer, so
+          * this does not allocate memory.
+          *
+          * \param[in] data pointer to size() elements */
+        virtual void
+        push (const T* data) = 0;
+
         inline size_t
         size () const
         {
           return (size_);
         }
 
+        /** Process elements of the buffer in parallel on a thread pool.
+          *
+          * The element range is split into tiles of \a tile_size elements,
+          * which are processed by the pool threads. Elements are independent,
+          * so the results are the same as in single-threaded mode. The pool
+          * may be shared between several buffers.
+          *
+          * \param[in] pool thread pool to use, pass an empty pointer to go
+          * back to single-threaded processing
+          * \param[in] tile_size number of elements in a tile (default: 16384) */
+        void
+        setThreadPool (const ThreadPool::Ptr& pool, size_t tile_size = 16384);
+
+        /** Process elements of the buffer in parallel on a thread pool owned by
+          * the buffer.
+          *
+          * \param[in] num_threads number of threads, 0 or 1 disables parallel
+          * processing */
+        void
+        setNumThreads (size_t num_threads);
+
       protected:
 
         Buffer (size_t size);
 
+        /** Call \a f (begin, end) for all element ranges, either once for the
+          * whole buffer, or tile by tile on the thread pool. */
+        template <typename F> void
+        forEachTile (F f) const;
+
         const size_t size_;
 
+        ThreadPool::Ptr thread_pool_;
+
+        size_t tile_size_;
+
     };
 
     template <typename T>
@@ -95,9 +209,15 @@ namespace pcl
         virtual T
         operator[] (size_t idx) const;
 
+        virtual void
+        read (T* out, size_t begin, size_t end) const;
+
         virtual void
         push (std::vector<T>& data);
 
+        virtual void
+        push (const T* data);
+
       private:
 
         std::vector<T> data_;
@@ -120,11 +240,20 @@ namespace pcl
         virtual T
         operator[] (size_t idx) const;
 
+        virtual void
+        read (T* out, size_t begin, size_t end) const;
+
         virtual void
         push (std::vector<T>& data);
 
+        virtual void
+        push (const T* data);
+
       private:
 
+        void
+        pushRange (const T* data, size_t begin, size_t end);
+
         /** Compare two data elements.
           *
           * Invalid value is assumed to be larger than everything else. If both values
@@ -137,15 +266,17 @@ namespace pcl
         const size_t midpoint_;
 
         /// Data pushed into the buffer (last window_size_ chunks), logically
-        /// organized as a circular buffer
-        std::vector<std::vector<T> > data_;
+        /// organized as a circular buffer. Stored window-major in a single
+        /// contiguous block, i.e. element i of chunk w is at w * size_ + i
+        std::vector<T> data_;
 
         /// Index of the last pushed data chunk in the data_ circular buffer
         size_t data_current_idx_;
 
         /// Indices that the argsort function would produce for data_ (with
-        /// dimensions swapped)
-        std::vector<std::vector<unsigned char> > data_argsort_indices_;
+        /// dimensions swapped). Stored pixel-major in a single contiguous
+        /// block, i.e. the indices of element i start at i * window_size_
+        std::vector<unsigned char> data_argsort_indices_;
 
         /// Number of invalid values in the buffer
         std::vector<unsigned char> data_invalid_count_;
@@ -154,6 +285,53 @@ namespace pcl
 
     };
 
+    /** Median buffer with the window size fixed at compile time.
+      *
+      * Produces the same results as MedianBuffer, but instead of maintaining
+      * sorted order of the window on every push, sorts it with a branch-free
+      * sorting network on read. The network is applied to several elements at
+      * once using SIMD instructions (for unsigned short data), which makes
+      * this much faster than MedianBuffer for small windows (3, 5, 7). */
+    template <typename T, size_t N>
+    class FixedMedianBuffer : public Buffer<T>
+    {
+
+      public:
+
+        FixedMedianBuffer (size_t size);
+
+        virtual
+        ~FixedMedianBuffer ();
+
+        virtual T
+        operator[] (size_t idx) const;
+
+        virtual void
+        read (T* out, size_t begin, size_t end) const;
+
+        virtual void
+        push (std::vector<T>& data);
+
+        virtual void
+        push (const T* data);
+
+      private:
+
+        void
+        readRange (T* out, size_t begin, size_t end) const;
+
+        /// Data pushed into the buffer (last N chunks), logically organized
+        /// as a circular buffer. Stored window-major in a single contiguous
+        /// block, i.e. element i of chunk w is at w * size_ + i
+        std::vector<T> data_;
+
+        /// Index of the last pushed data chunk in the data_ circular buffer
+        size_t data_current_idx_;
+
+        using Buffer<T>::size_;
+
+    };
+
     template <typename T>
     class AverageBuffer : public Buffer<T>
     {
@@ -168,22 +346,34 @@ namespace pcl
         virtual T
         operator[] (size_t idx) const;
 
+        virtual void
+        read (T* out, size_t begin, size_t end) const;
+
         virtual void
         push (std::vector<T>& data);
 
+        virtual void
+        push (const T* data);
+
       private:
 
+        typedef typename accumulator_traits<T>::type AccumulatorT;
+
+        void
+        pushRange (const T* data, size_t begin, size_t end);
+
         const size_t window_size_;
 
         /// Data pushed into the buffer (last window_size_ chunks), logically
-        /// organized as a circular buffer
-        std::vector<std::vector<T> > data_;
+        /// organized as a circular buffer. Stored window-major in a single
+        /// contiguous block, i.e. element i of chunk w is at w * size_ + i
+        std::vector<T> data_;
 
         /// Index of the last pushed data chunk in the data_ circular buffer
         size_t data_current_idx_;
 
-        /// Current sum of the buffer
-        std::vector<T> data_sum_;
+        /// Current sum of the valid values in the buffer
+        std::vector<AccumulatorT> data_sum_;
 
         /// Number of invalid values in the buffer
         std::vector<unsigned char> data_invalid_count_;
@@ -192,6 +382,279 @@ namespace pcl
 
     };
 
+    /** Exponential moving average buffer.
+      *
+      * Each element of the output is updated with every valid pushed value
+      * as state = state + alpha * (value - state). Unlike AverageBuffer, only
+      * the current state is stored, so memory consumption does not depend on
+      * the effective window length.
+      *
+      * Invalid values do not change the state, but the element becomes
+      * invalid once \a max_invalid_age consecutive invalid values have been
+      * pushed. The first valid value after that resets the state. */
+    template <typename T>
+    class ExponentialBuffer : public Buffer<T>
+    {
+
+      public:
+
+        /** Constructor.
+          *
+          * \param[in] size number of elements
+          * \param[in] alpha smoothing factor in (0, 1], larger values give
+          * more weight to recent data
+          * \param[in] max_invalid_age number of consecutive invalid values
+          * (1-255) after which an element becomes invalid */
+        ExponentialBuffer (size_t size, float alpha, size_t max_invalid_age = 1);
+
+        virtual
+        ~ExponentialBuffer ();
+
+        virtual T
+        operator[] (size_t idx) const;
+
+        virtual void
+        read (T* out, size_t begin, size_t end) const;
+
+        virtual void
+        push (std::vector<T>& data);
+
+        virtual void
+        push (const T* data);
+
+        inline float
+        getAlpha () const
+        {
+          return (alpha_);
+        }
+
+        void
+        setAlpha (float alpha);
+
+      private:
+
+        void
+        pushRange (const T* data, size_t begin, size_t end);
+
+        inline T
+        value (size_t idx) const;
+
+        float alpha_;
+
+        const unsigned char max_invalid_age_;
+
+        /// Current filtered values
+        std::vector<float> state_;
+
+        /// Number of consecutive invalid values pushed for each element
+        /// (saturates at max_invalid_age_)
+        std::vector<unsigned char> invalid_age_;
+
+        using Buffer<T>::size_;
+
+    };
+
+    /** Motion-adaptive average buffer.
+      *
+      * Each element is the average of the valid values pushed since the last
+      * restart of its history, computed incrementally. Once the history is
+      * \a window_size values long, new values are blended in with weight
+      * 1 / \a window_size. If a new value deviates from the current average by
+      * more than \a threshold, the history of the element is restarted from
+      * that value. Static regions are thus averaged over long windows, while
+      * moving regions follow the data without lag. Only the current average
+      * and two counters are stored per element.
+      *
+      * Invalid values do not change the average, but the element becomes
+      * invalid once \a window_size consecutive invalid values have been
+      * pushed. */
+    template <typename T>
+    class AdaptiveBuffer : public Buffer<T>
+    {
+
+      public:
+
+        /** Constructor.
+          *
+          * \param[in] size number of elements
+          * \param[in] window_size maximum length of element history (1-255)
+          * \param[in] threshold maximum deviation of a new value from the
+          * current average that does not restart the history (in data units,
+          * i.e. millimeters for depth) */
+        AdaptiveBuffer (size_t size, size_t window_size, float threshold);
+
+        virtual
+        ~AdaptiveBuffer ();
+
+        virtual T
+        operator[] (size_t idx) const;
+
+        virtual void
+        read (T* out, size_t begin, size_t end) const;
+
+        virtual void
+        push (std::vector<T>& data);
+
+        virtual void
+        push (const T* data);
+
+        inline float
+        getThreshold () const
+        {
+          return (threshold_);
+        }
+
+        void
+        setThreshold (float threshold);
+
+      private:
+
+        void
+        pushRange (const T* data, size_t begin, size_t end);
+
+        inline T
+        value (size_t idx) const;
+
+        const unsigned char window_size_;
+
+        float threshold_;
+
+        /// Current averages
+        std::vector<float> mean_;
+
+        /// Number of values in the history of each element (saturates at
+        /// window_size_)
+        std::vector<unsigned char> count_;
+
+        /// Number of consecutive invalid values pushed for each element
+        /// (saturates at window_size_)
+        std::vector<unsigned char> invalid_age_;
+
+        using Buffer<T>::size_;
+
+    };
+
+    /** Median buffer for depth data with large windows.
+      *
+      * Each element keeps a two-level histogram of its quantized values
+      * (quantization drops the \a quantization_bits low bits). The coarse
+      * level counts values by their high bits over the whole range. The fine
+      * level counts values by their low bits, but only within a couple of
+      * coarse bins (the one that holds the median and the one that held it
+      * before), so that an element that flips between two surfaces does not
+      * lose them. Pushing a value adjusts a few counters and moves the median
+      * by a few bins, so the cost per element does not depend on the window
+      * size. Only when the median moves into a coarse bin without fine
+      * counts (i.e. once after the scene changed) the fine counts of that bin
+      * are collected from the samples in the window.
+      *
+      * Histograms take about 1.5 KB per element with \a quantization_bits 0,
+      * and half as much for every two extra bits.
+      *
+      * With \a quantization_bits 0 the results are exactly the same as with
+      * MedianBuffer, otherwise the median is rounded down to a multiple of the
+      * bin width. Invalid values (0) are handled the same way as in
+      * MedianBuffer. The window size is limited to 65535. */
+    class HistogramMedianBuffer : public Buffer<unsigned short>
+    {
+
+      public:
+
+        /** Constructor.
+          *
+          * \param[in] size number of elements
+          * \param[in] window_size number of most recent chunks to compute
+          * median over (1-65535)
+          * \param[in] quantization_bits number of low bits of depth values
+          * dropped in the histogram (bin width is 2^quantization_bits) */
+        HistogramMedianBuffer (size_t size, size_t window_size, unsigned int quantization_bits = 0);
+
+        virtual
+        ~HistogramMedianBuffer ();
+
+        virtual unsigned short
+        operator[] (size_t idx) const;
+
+        virtual void
+        read (unsigned short* out, size_t begin, size_t end) const;
+
+        virtual void
+        push (std::vector<unsigned short>& data);
+
+        virtual void
+        push (const unsigned short* data);
+
+      private:
+
+        /// Number of coarse bins per element with fine counts
+        static const size_t NUM_FINE_SLOTS = 2;
+
+        /// Marks a fine slot that does not hold counts of any coarse bin
+        static const boost::uint16_t NO_COARSE_BIN = 0xFFFF;
+
+        /// Per-element counters
+        struct Element
+        {
+          /// Number of invalid values
+          boost::uint16_t invalid;
+          /// Current median (not quantized)
+          boost::uint16_t median;
+          /// Coarse bin that contains the median
+          boost::uint16_t median_coarse;
+          /// Number of valid values in coarse bins below median_coarse
+          boost::uint16_t below_coarse;
+          /// Fine bin (within median_coarse) that contains the median
+          boost::uint16_t median_fine;
+          /// Number of valid values in fine bins of median_coarse below
+          /// median_fine
+          boost::uint16_t below_fine;
+          /// Coarse bin whose fine counts each slot holds, or NO_COARSE_BIN
+          boost::uint16_t slot_coarse[NUM_FINE_SLOTS];
+          /// Slot that holds fine counts of median_coarse
+          boost::uint16_t median_slot;
+        };
+
+        void
+        pushRange (const unsigned short* data, size_t begin, size_t end);
+
+        /** Add (\a delta = 1) or remove (\a delta = -1) a valid quantized value
+          * to/from the histograms of an element. */
+        inline void
+        update (size_t idx, size_t q, int delta);
+
+        /** Make a fine slot of an element hold the counts of its median coarse
+          * bin, collecting them from the samples in the window if no slot
+          * does yet. */
+        void
+        selectSlot (size_t idx);
+
+        const size_t window_size_;
+        const unsigned int quantization_bits_;
+        /// Number of low bits of quantized values that select the fine bin
+        const unsigned int fine_bits_;
+        const size_t num_coarse_bins_;
+        const size_t num_fine_bins_;
+
+        /// Data pushed into the buffer (last window_size_ chunks), logically
+        /// organized as a circular buffer. Stored window-major in a single
+        /// contiguous block, i.e. element i of chunk w is at w * size_ + i
+        std::vector<unsigned short> data_;
+
+        /// Index of the last pushed data chunk in the data_ circular buffer
+        size_t data_current_idx_;
+
+        /// Coarse histograms, element i occupies bins
+        /// [i * num_coarse_bins_, (i + 1) * num_coarse_bins_)
+        std::vector<boost::uint16_t> coarse_;
+
+        /// Fine histograms, slot s of element i occupies bins starting at
+        /// (i * NUM_FINE_SLOTS + s) * num_fine_bins_
+        std::vector<boost::uint16_t> fine_;
+
+        std::vector<Element> elements_;
+
+    };
+
   }
 
 }
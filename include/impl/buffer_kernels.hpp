@@ -0,0 +1,446 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef PCL_IO_IMPL_BUFFER_KERNELS_HPP
+#define PCL_IO_IMPL_BUFFER_KERNELS_HPP
+
+#include <algorithm>
+#include <limits>
+
+#if defined (__AVX2__)
+  #define PCL_IO_BUFFERS_AVX2
+  #include <immintrin.h>
+#elif defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define PCL_IO_BUFFERS_SSE2
+  #include <emmintrin.h>
+#endif
+
+namespace pcl
+{
+
+  namespace io
+  {
+
+    namespace detail
+    {
+
+      /** Update running sums and invalid counts of an AverageBuffer with a
+        * new data chunk that replaces an old one (scalar version).
+        *
+        * Processes elements with indices [\a begin, \a end). */
+      template <typename T, typename A> inline void
+      averagePushScalar (const T* new_data,
+                         const T* old_data,
+                         A* sum,
+                         unsigned char* invalid_count,
+                         size_t begin,
+                         size_t end)
+      {
+        for (size_t i = begin; i < end; ++i)
+        {
+          bool new_is_nan = buffer_traits<T>::is_invalid (new_data[i]);
+          bool old_is_nan = buffer_traits<T>::is_invalid (old_data[i]);
+
+          if (!old_is_nan)
+            sum[i] -= old_data[i];
+          if (!new_is_nan)
+            sum[i] += new_data[i];
+
+          invalid_count[i] += new_is_nan - old_is_nan;
+        }
+      }
+
+      /** Compute averages from running sums and invalid counts of an
+        * AverageBuffer (scalar version).
+        *
+        * Element i of the range [\a begin, \a end) is written to
+        * out[i - begin]. */
+      template <typename T, typename A> inline void
+      averageReadScalar (const A* sum,
+                         const unsigned char* invalid_count,
+                         size_t window_size,
+                         T* out,
+                         size_t begin,
+                         size_t end)
+      {
+        for (size_t i = begin; i < end; ++i)
+        {
+          if (invalid_count[i] == window_size)
+            *out++ = buffer_traits<T>::invalid ();
+          else
+            *out++ = static_cast<T> (sum[i] / static_cast<A> (window_size - invalid_count[i]));
+        }
+      }
+
+      template <typename T, typename A> inline void
+      averagePush (const T* new_data,
+                   const T* old_data,
+                   A* sum,
+                   unsigned char* invalid_count,
+                   size_t begin,
+                   size_t end)
+      {
+        averagePushScalar (new_data, old_data, sum, invalid_count, begin, end);
+      }
+
+      template <typename T, typename A> inline void
+      averageRead (const A* sum,
+                   const unsigned char* invalid_count,
+                   size_t window_size,
+                   T* out,
+                   size_t begin,
+                   size_t end)
+      {
+        averageReadScalar (sum, invalid_count, window_size, out, begin, end);
+      }
+
+#if defined (PCL_IO_BUFFERS_AVX2) || defined (PCL_IO_BUFFERS_SSE2)
+
+      /* Vectorized kernels for depth data (unsigned short with uint32 sums).
+       *
+       * The invalid value for depth is 0, so invalid elements contribute
+       * nothing to the sums and can be added and subtracted unconditionally.
+       * Comparison masks (all ones for invalid elements, i.e. -1) are used to
+       * update invalid counts without branches. */
+
+      inline void
+      averagePush (const unsigned short* new_data,
+                   const unsigned short* old_data,
+                   boost::uint32_t* sum,
+                   unsigned char* invalid_count,
+                   size_t begin,
+                   size_t end)
+      {
+        size_t i = begin;
+        const __m128i zero = _mm_setzero_si128 ();
+#if defined (PCL_IO_BUFFERS_AVX2)
+        const __m256i zero256 = _mm256_setzero_si256 ();
+        for (; i + 16 <= end; i += 16)
+        {
+          __m256i n = _mm256_loadu_si256 (reinterpret_cast<const __m256i*> (new_data + i));
+          __m256i o = _mm256_loadu_si256 (reinterpret_cast<const __m256i*> (old_data + i));
+          __m256i* s = reinterpret_cast<__m256i*> (sum + i);
+          __m256i s_lo = _mm256_loadu_si256 (s);
+          __m256i s_hi = _mm256_loadu_si256 (s + 1);
+          s_lo = _mm256_sub_epi32 (s_lo, _mm256_cvtepu16_epi32 (_mm256_castsi256_si128 (o)));
+          s_lo = _mm256_add_epi32 (s_lo, _mm256_cvtepu16_epi32 (_mm256_castsi256_si128 (n)));
+          s_hi = _mm256_sub_epi32 (s_hi, _mm256_cvtepu16_epi32 (_mm256_extracti128_si256 (o, 1)));
+          s_hi = _mm256_add_epi32 (s_hi, _mm256_cvtepu16_epi32 (_mm256_extracti128_si256 (n, 1)));
+          _mm256_storeu_si256 (s, s_lo);
+          _mm256_storeu_si256 (s + 1, s_hi);
+          // delta is +1 where a valid value is replaced by an invalid one,
+          // -1 in the opposite case, and 0 otherwise
+          __m256i delta = _mm256_sub_epi16 (_mm256_cmpeq_epi16 (o, zero256), _mm256_cmpeq_epi16 (n, zero256));
+          __m128i delta8 = _mm_packs_epi16 (_mm256_castsi256_si128 (delta), _mm256_extracti128_si256 (delta, 1));
+          __m128i* c = reinterpret_cast<__m128i*> (invalid_count + i);
+          _mm_storeu_si128 (c, _mm_add_epi8 (_mm_loadu_si128 (c), delta8));
+        }
+#endif
+        for (; i + 8 <= end; i += 8)
+        {
+          __m128i n = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (new_data + i));
+          __m128i o = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (old_data + i));
+          __m128i* s = reinterpret_cast<__m128i*> (sum + i);
+          __m128i s_lo = _mm_loadu_si128 (s);
+          __m128i s_hi = _mm_loadu_si128 (s + 1);
+          s_lo = _mm_add_epi32 (_mm_sub_epi32 (s_lo, _mm_unpacklo_epi16 (o, zero)), _mm_unpacklo_epi16 (n, zero));
+          s_hi = _mm_add_epi32 (_mm_sub_epi32 (s_hi, _mm_unpackhi_epi16 (o, zero)), _mm_unpackhi_epi16 (n, zero));
+          _mm_storeu_si128 (s, s_lo);
+          _mm_storeu_si128 (s + 1, s_hi);
+          __m128i delta = _mm_sub_epi16 (_mm_cmpeq_epi16 (o, zero), _mm_cmpeq_epi16 (n, zero));
+          __m128i* c = reinterpret_cast<__m128i*> (invalid_count + i);
+          _mm_storel_epi64 (c, _mm_add_epi8 (_mm_loadl_epi64 (c), _mm_packs_epi16 (delta, zero)));
+        }
+        averagePushScalar (new_data, old_data, sum, invalid_count, i, end);
+      }
+
+      inline void
+      averageRead (const boost::uint32_t* sum,
+                   const unsigned char* invalid_count,
+                   size_t window_size,
+                   unsigned short* out,
+                   size_t begin,
+                   size_t end)
+      {
+        // Sums do not exceed 255 * 65535 < 2^24, so they (and the quotients)
+        // are represented exactly in double precision and truncating double
+        // division matches integer division. Elements with all values invalid
+        // have zero sums, so clamping the divisor to 1 produces the invalid
+        // value 0 for them.
+        size_t i = begin;
+        const __m128i zero = _mm_setzero_si128 ();
+        const __m128i one = _mm_set1_epi16 (1);
+        const __m128i window = _mm_set1_epi16 (static_cast<short> (window_size));
+        for (; i + 8 <= end; i += 8)
+        {
+          const __m128i* s = reinterpret_cast<const __m128i*> (sum + i);
+          __m128i c = _mm_unpacklo_epi8 (_mm_loadl_epi64 (reinterpret_cast<const __m128i*> (invalid_count + i)), zero);
+          __m128i divisor = _mm_max_epi16 (_mm_sub_epi16 (window, c), one);
+#if defined (PCL_IO_BUFFERS_AVX2)
+          __m256d q0 = _mm256_div_pd (_mm256_cvtepi32_pd (_mm_loadu_si128 (s)),
+                                      _mm256_cvtepi32_pd (_mm_unpacklo_epi16 (divisor, zero)));
+          __m256d q1 = _mm256_div_pd (_mm256_cvtepi32_pd (_mm_loadu_si128 (s + 1)),
+                                      _mm256_cvtepi32_pd (_mm_unpackhi_epi16 (divisor, zero)));
+          __m128i r = _mm_packus_epi32 (_mm256_cvttpd_epi32 (q0), _mm256_cvttpd_epi32 (q1));
+#else
+          __m128i s_lo = _mm_loadu_si128 (s);
+          __m128i s_hi = _mm_loadu_si128 (s + 1);
+          __m128i d_lo = _mm_unpacklo_epi16 (divisor, zero);
+          __m128i d_hi = _mm_unpackhi_epi16 (divisor, zero);
+          __m128i q0 = _mm_cvttpd_epi32 (_mm_div_pd (_mm_cvtepi32_pd (s_lo), _mm_cvtepi32_pd (d_lo)));
+          __m128i q1 = _mm_cvttpd_epi32 (_mm_div_pd (_mm_cvtepi32_pd (_mm_srli_si128 (s_lo, 8)), _mm_cvtepi32_pd (_mm_srli_si128 (d_lo, 8))));
+          __m128i q2 = _mm_cvttpd_epi32 (_mm_div_pd (_mm_cvtepi32_pd (s_hi), _mm_cvtepi32_pd (d_hi)));
+          __m128i q3 = _mm_cvttpd_epi32 (_mm_div_pd (_mm_cvtepi32_pd (_mm_srli_si128 (s_hi, 8)), _mm_cvtepi32_pd (_mm_srli_si128 (d_hi, 8))));
+          __m128i r_lo = _mm_unpacklo_epi64 (q0, q1);
+          __m128i r_hi = _mm_unpacklo_epi64 (q2, q3);
+          // SSE2 lacks unsigned saturating pack, sign-extend the low 16 bits so
+          // that signed pack leaves them untouched
+          r_lo = _mm_srai_epi32 (_mm_slli_epi32 (r_lo, 16), 16);
+          r_hi = _mm_srai_epi32 (_mm_slli_epi32 (r_hi, 16), 16);
+          __m128i r = _mm_packs_epi32 (r_lo, r_hi);
+#endif
+          _mm_storeu_si128 (reinterpret_cast<__m128i*> (out), r);
+          out += 8;
+        }
+        averageReadScalar (sum, invalid_count, window_size, out, i, end);
+      }
+
+#endif
+
+      /** Odd-even transposition sorting network of size N.
+        *
+        * Sorts an array of N values with N rounds of compare-exchange
+        * operations, generated (and unrolled) at compile time. The Ops
+        * template argument of sort() provides an exchange() function that
+        * puts the minimum of two values in the first one and the maximum in
+        * the second one, which allows to use the same network for scalars and
+        * SIMD registers. */
+      template <size_t N, size_t Round, size_t J,
+                bool EndOfRound = (J + 1 >= N), bool EndOfSort = (Round >= N)>
+      struct SortingNetwork
+      {
+        template <typename Ops, typename V> static inline void
+        sort (V* v)
+        {
+          Ops::exchange (v[J], v[J + 1]);
+          SortingNetwork<N, Round, J + 2>::template sort<Ops> (v);
+        }
+      };
+
+      template <size_t N, size_t Round, size_t J>
+      struct SortingNetwork<N, Round, J, true, false>
+      {
+        template <typename Ops, typename V> static inline void
+        sort (V* v)
+        {
+          SortingNetwork<N, Round + 1, (Round + 1) % 2>::template sort<Ops> (v);
+        }
+      };
+
+      template <size_t N, size_t Round, size_t J, bool EndOfRound>
+      struct SortingNetwork<N, Round, J, EndOfRound, true>
+      {
+        template <typename Ops, typename V> static inline void
+        sort (V*)
+        {
+        }
+      };
+
+      template <typename T>
+      struct ScalarMinMax
+      {
+        static inline void
+        exchange (T& a, T& b)
+        {
+          T min = std::min (a, b);
+          b = std::max (a, b);
+          a = min;
+        }
+      };
+
+      /** Compute medians of the last N chunks pushed into a FixedMedianBuffer
+        * (scalar version).
+        *
+        * Invalid values are replaced with the largest representable value
+        * before sorting, so that they end up at the back of the sorted window,
+        * same as with MedianBuffer::compare().
+        *
+        * \param[in] data window-major data of N chunks of \a size elements
+        * \param[in] size number of elements in a chunk
+        * \param[out] out element i of the range [\a begin, \a end) is written
+        * to out[i - begin] */
+      template <size_t N, typename T> inline void
+      fixedMedianReadScalar (const T* data,
+                             size_t size,
+                             T* out,
+                             size_t begin,
+                             size_t end)
+      {
+        const T largest = std::numeric_limits<T>::has_infinity ?
+                          std::numeric_limits<T>::infinity () :
+                          std::numeric_limits<T>::max ();
+        for (size_t i = begin; i < end; ++i)
+        {
+          T v[N];
+          size_t invalid_count = 0;
+          for (size_t k = 0; k < N; ++k)
+          {
+            T value = data[k * size + i];
+            bool is_invalid = buffer_traits<T>::is_invalid (value);
+            invalid_count += is_invalid;
+            v[k] = is_invalid ? largest : value;
+          }
+          SortingNetwork<N, 0, 0>::template sort<ScalarMinMax<T> > (v);
+          *out++ = invalid_count == N ? buffer_traits<T>::invalid () : v[(N - invalid_count) / 2];
+        }
+      }
+
+      template <size_t N, typename T> inline void
+      fixedMedianRead (const T* data,
+                       size_t size,
+                       T* out,
+                       size_t begin,
+                       size_t end)
+      {
+        fixedMedianReadScalar<N> (data, size, out, begin, end);
+      }
+
+#if defined (PCL_IO_BUFFERS_AVX2) || defined (PCL_IO_BUFFERS_SSE2)
+
+      /* Vectorized median kernel for depth data (unsigned short).
+       *
+       * Invalid depth (0) is replaced with 0xFFFF by OR-ing values with their
+       * comparison masks. After sorting, the median of each lane is picked
+       * with masks computed from its own number of invalid values. SSE2 only
+       * has signed 16-bit min/max, so values are biased by 0x8000 to turn
+       * unsigned order into signed order. */
+
+      struct Epi16MinMax
+      {
+        static inline void
+        exchange (__m128i& a, __m128i& b)
+        {
+          __m128i min = _mm_min_epi16 (a, b);
+          b = _mm_max_epi16 (a, b);
+          a = min;
+        }
+      };
+
+#if defined (PCL_IO_BUFFERS_AVX2)
+      struct Epu16MinMax256
+      {
+        static inline void
+        exchange (__m256i& a, __m256i& b)
+        {
+          __m256i min = _mm256_min_epu16 (a, b);
+          b = _mm256_max_epu16 (a, b);
+          a = min;
+        }
+      };
+#endif
+
+      template <size_t N> inline void
+      fixedMedianRead (const unsigned short* data,
+                       size_t size,
+                       unsigned short* out,
+                       size_t begin,
+                       size_t end)
+      {
+        size_t i = begin;
+#if defined (PCL_IO_BUFFERS_AVX2)
+        {
+          const __m256i zero = _mm256_setzero_si256 ();
+          const __m256i all_invalid = _mm256_set1_epi16 (N);
+          for (; i + 16 <= end; i += 16)
+          {
+            __m256i v[N];
+            __m256i invalid_count = zero;
+            for (size_t k = 0; k < N; ++k)
+            {
+              __m256i x = _mm256_loadu_si256 (reinterpret_cast<const __m256i*> (data + k * size + i));
+              __m256i mask = _mm256_cmpeq_epi16 (x, zero);
+              invalid_count = _mm256_sub_epi16 (invalid_count, mask);
+              v[k] = _mm256_or_si256 (x, mask);
+            }
+            SortingNetwork<N, 0, 0>::template sort<Epu16MinMax256> (v);
+            __m256i midpoint = _mm256_srli_epi16 (_mm256_sub_epi16 (all_invalid, invalid_count), 1);
+            __m256i r = zero;
+            for (size_t k = 0; k <= N / 2; ++k)
+              r = _mm256_or_si256 (r, _mm256_and_si256 (v[k], _mm256_cmpeq_epi16 (midpoint, _mm256_set1_epi16 (k))));
+            r = _mm256_andnot_si256 (_mm256_cmpeq_epi16 (invalid_count, all_invalid), r);
+            _mm256_storeu_si256 (reinterpret_cast<__m256i*> (out), r);
+            out += 16;
+          }
+        }
+#endif
+        const __m128i zero = _mm_setzero_si128 ();
+        const __m128i bias = _mm_set1_epi16 (static_cast<short> (0x8000));
+        const __m128i all_invalid = _mm_set1_epi16 (N);
+        for (; i + 8 <= end; i += 8)
+        {
+          __m128i v[N];
+          __m128i invalid_count = zero;
+          for (size_t k = 0; k < N; ++k)
+          {
+            __m128i x = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (data + k * size + i));
+            __m128i mask = _mm_cmpeq_epi16 (x, zero);
+            invalid_count = _mm_sub_epi16 (invalid_count, mask);
+            v[k] = _mm_xor_si128 (_mm_or_si128 (x, mask), bias);
+          }
+          SortingNetwork<N, 0, 0>::template sort<Epi16MinMax> (v);
+          __m128i midpoint = _mm_srli_epi16 (_mm_sub_epi16 (all_invalid, invalid_count), 1);
+          __m128i r = zero;
+          for (size_t k = 0; k <= N / 2; ++k)
+            r = _mm_or_si128 (r, _mm_and_si128 (v[k], _mm_cmpeq_epi16 (midpoint, _mm_set1_epi16 (k))));
+          r = _mm_xor_si128 (r, bias);
+          r = _mm_andnot_si128 (_mm_cmpeq_epi16 (invalid_count, all_invalid), r);
+          _mm_storeu_si128 (reinterpret_cast<__m128i*> (out), r);
+          out += 8;
+        }
+        fixedMedianReadScalar<N> (data, size, out, i, end);
+      }
+
+#endif
+
+    }
+
+  }
+
+}
+
+#endif /* PCL_IO_IMPL_BUFFER_KERNELS_HPP */
+
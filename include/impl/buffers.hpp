@@ -37,6 +37,8 @@
 
 #include <iostream>
 #include <cstring>
+#include <algorithm>
+#include <cmath>
 
 #include <pcl/pcl_macros.h>
 
@@ -56,9 +58,12 @@ struct buffer_traits <float>
   static bool is_invalid (float value) { return pcl_isnan (value); };
 };
 
+#include "impl/buffer_kernels.hpp"
+
 template <typename T>
 pcl::io::Buffer<T>::Buffer (size_t size)
 : size_ (size)
+, tile_size_ (size)
 {
 }
 
@@ -67,6 +72,31 @@ pcl::io::Buffer<T>::~Buffer ()
 {
 }
 
+template <typename T> void
+pcl::io::Buffer<T>::setThreadPool (const ThreadPool::Ptr& pool, size_t tile_size)
+{
+  thread_pool_ = pool;
+  tile_size_ = tile_size;
+}
+
+template <typename T> void
+pcl::io::Buffer<T>::setNumThreads (size_t num_threads)
+{
+  if (num_threads > 1)
+    setThreadPool (ThreadPool::Ptr (new ThreadPool (num_threads)));
+  else
+    setThreadPool (ThreadPool::Ptr ());
+}
+
+template <typename T> template <typename F> void
+pcl::io::Buffer<T>::forEachTile (F f) const
+{
+  if (thread_pool_)
+    thread_pool_->parallelFor (0, size_, tile_size_, f);
+  else
+    f (0, size_);
+}
+
 template <typename T>
 pcl::io::SingleBuffer<T>::SingleBuffer (size_t size)
 : Buffer<T> (size)
@@ -86,6 +116,13 @@ pcl::io::SingleBuffer<T>::operator[] (size_t idx) const
   return (data_[idx]);
 }
 
+template <typename T> void
+pcl::io::SingleBuffer<T>::read (T* out, size_t begin, size_t end) const
+{
+  assert (begin <= end && end <= size_);
+  std::copy (data_.begin () + begin, data_.begin () + end, out);
+}
+
 template <typename T> void
 pcl::io::SingleBuffer<T>::push (std::vector<T>& data)
 {
@@ -94,6 +131,12 @@ pcl::io::SingleBuffer<T>::push (std::vector<T>& data)
   data.clear ();
 }
 
+template <typename T> void
+pcl::io::SingleBuffer<T>::push (const T* data)
+{
+  std::copy (data, data + size_, data_.begin ());
+}
+
 template <typename T>
 pcl::io::MedianBuffer<T>::MedianBuffer (size_t size,
                                         size_t window_size)
@@ -106,17 +149,12 @@ pcl::io::MedianBuffer<T>::MedianBuffer (size_t size,
   assert (window_size_ > 0 &&
           window_size_ <= std::numeric_limits<unsigned char>::max ());
 
-  data_.resize (window_size_);
-  for (size_t i = 0; i < window_size_; ++i)
-    data_[i].resize (size_, buffer_traits<T>::invalid ());
+  data_.resize (window_size_ * size_, buffer_traits<T>::invalid ());
 
-  data_argsort_indices_.resize (size_);
+  data_argsort_indices_.resize (size_ * window_size_);
   for (size_t i = 0; i < size_; ++i)
-  {
-    data_argsort_indices_[i].resize (window_size_);
     for (size_t j = 0; j < window_size_; ++j)
-      data_argsort_indices_[i][j] = j;
-  }
+      data_argsort_indices_[i * window_size_ + j] = j;
 
   data_invalid_count_.resize (size_, window_size_);
 }
@@ -131,29 +169,58 @@ pcl::io::MedianBuffer<T>::operator[] (size_t idx) const
 {
   assert (idx < size_);
   int midpoint = (window_size_ - data_invalid_count_[idx]) / 2;
-  return (data_[data_argsort_indices_[idx][midpoint]][idx]);
+  return (data_[data_argsort_indices_[idx * window_size_ + midpoint] * size_ + idx]);
+}
+
+template <typename T> void
+pcl::io::MedianBuffer<T>::read (T* out, size_t begin, size_t end) const
+{
+  assert (begin <= end && end <= size_);
+  const unsigned char* argsort_indices = &data_argsort_indices_[begin * window_size_];
+  for (size_t i = begin; i < end; ++i, argsort_indices += window_size_)
+  {
+    size_t midpoint = (window_size_ - data_invalid_count_[i]) / 2;
+    *out++ = data_[argsort_indices[midpoint] * size_ + i];
+  }
 }
 
 template <typename T> void
 pcl::io::MedianBuffer<T>::push (std::vector<T>& data)
 {
   assert (data.size () == size_);
+  push (data.data ());
+  data.clear ();
+}
 
+template <typename T> void
+pcl::io::MedianBuffer<T>::push (const T* data)
+{
   if (++data_current_idx_ >= window_size_)
     data_current_idx_ = 0;
 
+  this->forEachTile (boost::bind (&MedianBuffer<T>::pushRange, this, data, _1, _2));
+}
+
+template <typename T> void
+pcl::io::MedianBuffer<T>::pushRange (const T* data, size_t begin, size_t end)
+{
+  // Pointer to the first element of the i-th pixel in the data_ slab; samples
+  // of the same pixel are size_ elements apart
+  const T* pixel = &data_[begin];
+  T* current = &data_[data_current_idx_ * size_];
+  unsigned char* argsort_indices = &data_argsort_indices_[begin * window_size_];
+
   // New data will replace the column with index data_current_idx_. Before
   // overwriting it, we go through all the new-old value pairs and update
   // data_argsort_indices_ to maintain sorted order.
-  for (size_t i = 0; i < size_; ++i)
+  for (size_t i = begin; i < end; ++i, ++pixel, argsort_indices += window_size_)
   {
     const T& new_value = data[i];
-    const T& old_value = data_[data_current_idx_][i];
+    const T& old_value = current[i];
     bool new_is_nan = buffer_traits<T>::is_invalid (new_value);
     bool old_is_nan = buffer_traits<T>::is_invalid (old_value);
     if (compare (new_value, old_value) == 0)
       continue;
-    std::vector<unsigned char>& argsort_indices = data_argsort_indices_[i];
     // Rewrite the argsort indices before or after the position where we insert
     // depending on the relation between the old and new values
     if (compare (new_value, old_value) == 1)
@@ -162,7 +229,7 @@ pcl::io::MedianBuffer<T>::push (std::vector<T>& data)
         if (argsort_indices[j] == data_current_idx_)
         {
           int k = j + 1;
-          while (k < window_size_ && compare (new_value, data_[argsort_indices[k]][i]) == 1)
+          while (k < window_size_ && compare (new_value, pixel[argsort_indices[k] * size_]) == 1)
           {
             std::swap (argsort_indices[k - 1], argsort_indices[k]);
             ++k;
@@ -176,7 +243,7 @@ pcl::io::MedianBuffer<T>::push (std::vector<T>& data)
         if (argsort_indices[j] == data_current_idx_)
         {
           int k = j - 1;
-          while (k >= 0 && compare (new_value, data_[argsort_indices[k]][i]) == -1)
+          while (k >= 0 && compare (new_value, pixel[argsort_indices[k] * size_]) == -1)
           {
             std::swap (argsort_indices[k], argsort_indices[k + 1]);
             --k;
@@ -192,8 +259,7 @@ pcl::io::MedianBuffer<T>::push (std::vector<T>& data)
   }
 
   // Finally overwrite the data
-  data_[data_current_idx_].swap (data);
-  data.clear ();
+  std::copy (data + begin, data + end, current + begin);
 }
 
 template <typename T> int
@@ -212,6 +278,63 @@ pcl::io::MedianBuffer<T>::compare (T a, T b)
   return a > b ? 1 : -1;
 }
 
+template <typename T, size_t N>
+pcl::io::FixedMedianBuffer<T, N>::FixedMedianBuffer (size_t size)
+: Buffer<T> (size)
+, data_current_idx_ (N - 1)
+{
+  assert (size_ > 0);
+  assert (N > 0);
+  data_.resize (N * size_, buffer_traits<T>::invalid ());
+}
+
+template <typename T, size_t N>
+pcl::io::FixedMedianBuffer<T, N>::~FixedMedianBuffer ()
+{
+}
+
+template <typename T, size_t N> T
+pcl::io::FixedMedianBuffer<T, N>::operator[] (size_t idx) const
+{
+  assert (idx < size_);
+  T value;
+  pcl::io::detail::fixedMedianReadScalar<N> (data_.data (), size_, &value, idx, idx + 1);
+  return (value);
+}
+
+template <typename T, size_t N> void
+pcl::io::FixedMedianBuffer<T, N>::read (T* out, size_t begin, size_t end) const
+{
+  assert (begin <= end && end <= size_);
+  if (begin == 0 && end == size_)
+    this->forEachTile (boost::bind (&FixedMedianBuffer<T, N>::readRange, this, out, _1, _2));
+  else
+    pcl::io::detail::fixedMedianRead<N> (data_.data (), size_, out, begin, end);
+}
+
+template <typename T, size_t N> void
+pcl::io::FixedMedianBuffer<T, N>::readRange (T* out, size_t begin, size_t end) const
+{
+  // Note that out points to the memory for the element with index 0
+  pcl::io::detail::fixedMedianRead<N> (data_.data (), size_, out + begin, begin, end);
+}
+
+template <typename T, size_t N> void
+pcl::io::FixedMedianBuffer<T, N>::push (std::vector<T>& data)
+{
+  assert (data.size () == size_);
+  push (data.data ());
+  data.clear ();
+}
+
+template <typename T, size_t N> void
+pcl::io::FixedMedianBuffer<T, N>::push (const T* data)
+{
+  if (++data_current_idx_ >= N)
+    data_current_idx_ = 0;
+  std::copy (data, data + size_, &data_[data_current_idx_ * size_]);
+}
+
 template <typename T>
 pcl::io::AverageBuffer<T>::AverageBuffer (size_t size,
                                           size_t window_size)
@@ -223,10 +346,7 @@ pcl::io::AverageBuffer<T>::AverageBuffer (size_t size,
   assert (window_size_ > 0 &&
           window_size_ <= std::numeric_limits<unsigned char>::max ());
 
-  data_.resize (window_size_);
-  for (size_t i = 0; i < window_size_; ++i)
-    data_[i].resize (size_, buffer_traits<T>::invalid ());
-
+  data_.resize (window_size_ * size_, buffer_traits<T>::invalid ());
   data_sum_.resize (size_, 0);
   data_invalid_count_.resize (size_, window_size_);
 }
@@ -243,40 +363,402 @@ pcl::io::AverageBuffer<T>::operator[] (size_t idx) const
   if (data_invalid_count_[idx] == window_size_)
     return (buffer_traits<T>::invalid ());
   else
-    return (data_sum_[idx] / (window_size_ - data_invalid_count_[idx]));
+    return (static_cast<T> (data_sum_[idx] / static_cast<AccumulatorT> (window_size_ - data_invalid_count_[idx])));
+}
+
+template <typename T> void
+pcl::io::AverageBuffer<T>::read (T* out, size_t begin, size_t end) const
+{
+  assert (begin <= end && end <= size_);
+  pcl::io::detail::averageRead (data_sum_.data (), data_invalid_count_.data (), window_size_, out, begin, end);
 }
 
 template <typename T> void
 pcl::io::AverageBuffer<T>::push (std::vector<T>& data)
 {
   assert (data.size () == size_);
+  push (data.data ());
+  data.clear ();
+}
 
+template <typename T> void
+pcl::io::AverageBuffer<T>::push (const T* data)
+{
   if (++data_current_idx_ >= window_size_)
     data_current_idx_ = 0;
 
+  this->forEachTile (boost::bind (&AverageBuffer<T>::pushRange, this, data, _1, _2));
+}
+
+template <typename T> void
+pcl::io::AverageBuffer<T>::pushRange (const T* data, size_t begin, size_t end)
+{
   // New data will replace the column with index data_current_idx_. Before
   // overwriting it, we go through the old values and subtract them from the
   // data_sum_
-  for (size_t i = 0; i < size_; ++i)
+  T* current = &data_[data_current_idx_ * size_];
+  pcl::io::detail::averagePush (data, current, data_sum_.data (), data_invalid_count_.data (), begin, end);
+
+  // Finally overwrite the data
+  std::copy (data + begin, data + end, current + begin);
+}
+
+template <typename T>
+pcl::io::ExponentialBuffer<T>::ExponentialBuffer (size_t size,
+                                                  float alpha,
+                                                  size_t max_invalid_age)
+: Buffer<T> (size)
+, alpha_ (alpha)
+, max_invalid_age_ (max_invalid_age)
+{
+  assert (size_ > 0);
+  assert (alpha_ > 0.0f && alpha_ <= 1.0f);
+  assert (max_invalid_age > 0 &&
+          max_invalid_age <= std::numeric_limits<unsigned char>::max ());
+
+  state_.resize (size_, 0.0f);
+  invalid_age_.resize (size_, max_invalid_age_);
+}
+
+template <typename T>
+pcl::io::ExponentialBuffer<T>::~ExponentialBuffer ()
+{
+}
+
+template <typename T> void
+pcl::io::ExponentialBuffer<T>::setAlpha (float alpha)
+{
+  assert (alpha > 0.0f && alpha <= 1.0f);
+  alpha_ = alpha;
+}
+
+template <typename T> T
+pcl::io::ExponentialBuffer<T>::value (size_t idx) const
+{
+  if (invalid_age_[idx] == max_invalid_age_)
+    return (buffer_traits<T>::invalid ());
+  if (std::numeric_limits<T>::is_integer)
+    return (static_cast<T> (std::floor (state_[idx] + 0.5f)));
+  return (static_cast<T> (state_[idx]));
+}
+
+template <typename T> T
+pcl::io::ExponentialBuffer<T>::operator[] (size_t idx) const
+{
+  assert (idx < size_);
+  return (value (idx));
+}
+
+template <typename T> void
+pcl::io::ExponentialBuffer<T>::read (T* out, size_t begin, size_t end) const
+{
+  assert (begin <= end && end <= size_);
+  for (size_t i = begin; i < end; ++i)
+    *out++ = value (i);
+}
+
+template <typename T> void
+pcl::io::ExponentialBuffer<T>::push (std::vector<T>& data)
+{
+  assert (data.size () == size_);
+  push (data.data ());
+  data.clear ();
+}
+
+template <typename T> void
+pcl::io::ExponentialBuffer<T>::push (const T* data)
+{
+  this->forEachTile (boost::bind (&ExponentialBuffer<T>::pushRange, this, data, _1, _2));
+}
+
+template <typename T> void
+pcl::io::ExponentialBuffer<T>::pushRange (const T* data, size_t begin, size_t end)
+{
+  for (size_t i = begin; i < end; ++i)
   {
-    const float& new_value = data[i];
-    const float& old_value = data_[data_current_idx_][i];
-    bool new_is_nan = buffer_traits<T>::is_invalid (new_value);
-    bool old_is_nan = buffer_traits<T>::is_invalid (old_value);
+    if (buffer_traits<T>::is_invalid (data[i]))
+    {
+      if (invalid_age_[i] < max_invalid_age_)
+        ++invalid_age_[i];
+    }
+    else
+    {
+      // Restart from the new value if the element is invalid
+      if (invalid_age_[i] == max_invalid_age_)
+        state_[i] = data[i];
+      else
+        state_[i] += alpha_ * (data[i] - state_[i]);
+      invalid_age_[i] = 0;
+    }
+  }
+}
+
+template <typename T>
+pcl::io::AdaptiveBuffer<T>::AdaptiveBuffer (size_t size,
+                                            size_t window_size,
+                                            float threshold)
+: Buffer<T> (size)
+, window_size_ (window_size)
+, threshold_ (threshold)
+{
+  assert (size_ > 0);
+  assert (window_size > 0 &&
+          window_size <= std::numeric_limits<unsigned char>::max ());
 
-    if (!old_is_nan)
-      data_sum_[i] -= old_value;
-    if (!new_is_nan)
-      data_sum_[i] += new_value;
+  mean_.resize (size_, 0.0f);
+  count_.resize (size_, 0);
+  invalid_age_.resize (size_, window_size_);
+}
 
-    if (new_is_nan && !old_is_nan)
-      ++data_invalid_count_[i];
-    else if (!new_is_nan && old_is_nan)
-      --data_invalid_count_[i];
+template <typename T>
+pcl::io::AdaptiveBuffer<T>::~AdaptiveBuffer ()
+{
+}
+
+template <typename T> void
+pcl::io::AdaptiveBuffer<T>::setThreshold (float threshold)
+{
+  threshold_ = threshold;
+}
+
+template <typename T> T
+pcl::io::AdaptiveBuffer<T>::value (size_t idx) const
+{
+  if (invalid_age_[idx] == window_size_)
+    return (buffer_traits<T>::invalid ());
+  if (std::numeric_limits<T>::is_integer)
+    return (static_cast<T> (std::floor (mean_[idx] + 0.5f)));
+  return (static_cast<T> (mean_[idx]));
+}
+
+template <typename T> T
+pcl::io::AdaptiveBuffer<T>::operator[] (size_t idx) const
+{
+  assert (idx < size_);
+  return (value (idx));
+}
+
+template <typename T> void
+pcl::io::AdaptiveBuffer<T>::read (T* out, size_t begin, size_t end) const
+{
+  assert (begin <= end && end <= size_);
+  for (size_t i = begin; i < end; ++i)
+    *out++ = value (i);
+}
+
+template <typename T> void
+pcl::io::AdaptiveBuffer<T>::push (std::vector<T>& data)
+{
+  assert (data.size () == size_);
+  push (data.data ());
+  data.clear ();
+}
+
+template <typename T> void
+pcl::io::AdaptiveBuffer<T>::push (const T* data)
+{
+  this->forEachTile (boost::bind (&AdaptiveBuffer<T>::pushRange, this, data, _1, _2));
+}
+
+template <typename T> void
+pcl::io::AdaptiveBuffer<T>::pushRange (const T* data, size_t begin, size_t end)
+{
+  for (size_t i = begin; i < end; ++i)
+  {
+    if (buffer_traits<T>::is_invalid (data[i]))
+    {
+      if (invalid_age_[i] < window_size_)
+        ++invalid_age_[i];
+      // History of an element that became invalid is lost
+      if (invalid_age_[i] == window_size_)
+        count_[i] = 0;
+      continue;
+    }
+    float deviation = data[i] - mean_[i];
+    if (count_[i] == 0 || std::fabs (deviation) > threshold_)
+    {
+      mean_[i] = data[i];
+      count_[i] = 1;
+    }
+    else
+    {
+      if (count_[i] < window_size_)
+        ++count_[i];
+      mean_[i] += deviation / count_[i];
+    }
+    invalid_age_[i] = 0;
   }
+}
 
-  // Finally overwrite the data
-  data_[data_current_idx_].swap (data);
+inline
+pcl::io::HistogramMedianBuffer::HistogramMedianBuffer (size_t size,
+                                                      size_t window_size,
+                                                      unsigned int quantization_bits)
+: Buffer<unsigned short> (size)
+, window_size_ (window_size)
+, quantization_bits_ (quantization_bits)
+, fine_bits_ ((16 - quantization_bits) / 2)
+, num_coarse_bins_ (size_t (1) << (16 - quantization_bits - fine_bits_))
+, num_fine_bins_ (size_t (1) << fine_bits_)
+, data_current_idx_ (window_size_ - 1)
+{
+  assert (size_ > 0);
+  assert (window_size_ > 0 &&
+          window_size_ <= std::numeric_limits<boost::uint16_t>::max ());
+  assert (quantization_bits_ < 16);
+
+  data_.resize (window_size_ * size_, 0);
+  coarse_.resize (size_ * num_coarse_bins_, 0);
+  fine_.resize (size_ * NUM_FINE_SLOTS * num_fine_bins_, 0);
+  Element element = {static_cast<boost::uint16_t> (window_size_), 0, 0, 0, 0, 0, {}, 0};
+  for (size_t s = 0; s < NUM_FINE_SLOTS; ++s)
+    element.slot_coarse[s] = NO_COARSE_BIN;
+  elements_.resize (size_, element);
+}
+
+inline
+pcl::io::HistogramMedianBuffer::~HistogramMedianBuffer ()
+{
+}
+
+inline unsigned short
+pcl::io::HistogramMedianBuffer::operator[] (size_t idx) const
+{
+  assert (idx < size_);
+  return (elements_[idx].median);
+}
+
+inline void
+pcl::io::HistogramMedianBuffer::read (unsigned short* out, size_t begin, size_t end) const
+{
+  assert (begin <= end && end <= size_);
+  for (size_t i = begin; i < end; ++i)
+    *out++ = elements_[i].median;
+}
+
+inline void
+pcl::io::HistogramMedianBuffer::push (std::vector<unsigned short>& data)
+{
+  assert (data.size () == size_);
+  push (data.data ());
   data.clear ();
 }
 
+inline void
+pcl::io::HistogramMedianBuffer::push (const unsigned short* data)
+{
+  if (++data_current_idx_ >= window_size_)
+    data_current_idx_ = 0;
+
+  this->forEachTile (boost::bind (&HistogramMedianBuffer::pushRange, this, data, _1, _2));
+}
+
+inline void
+pcl::io::HistogramMedianBuffer::update (size_t idx, size_t q, int delta)
+{
+  Element& element = elements_[idx];
+  const size_t coarse = q >> fine_bits_;
+  const size_t fine = q & (num_fine_bins_ - 1);
+  coarse_[idx * num_coarse_bins_ + coarse] += delta;
+  for (size_t s = 0; s < NUM_FINE_SLOTS; ++s)
+    if (element.slot_coarse[s] == coarse)
+      fine_[(idx * NUM_FINE_SLOTS + s) * num_fine_bins_ + fine] += delta;
+  if (coarse < element.median_coarse)
+    element.below_coarse += delta;
+  else if (coarse == element.median_coarse && fine < element.median_fine)
+    element.below_fine += delta;
+}
+
+inline void
+pcl::io::HistogramMedianBuffer::pushRange (const unsigned short* data, size_t begin, size_t end)
+{
+  unsigned short* current = &data_[data_current_idx_ * size_];
+
+  for (size_t i = begin; i < end; ++i)
+  {
+    const unsigned short new_value = data[i];
+    const unsigned short old_value = current[i];
+    if (old_value == new_value)
+      continue;
+    current[i] = new_value;
+
+    Element& element = elements_[i];
+    if (old_value == 0)
+      --element.invalid;
+    else
+      update (i, old_value >> quantization_bits_, -1);
+    if (new_value == 0)
+      ++element.invalid;
+    else
+      update (i, new_value >> quantization_bits_, 1);
+
+    size_t num_valid = window_size_ - element.invalid;
+    if (num_valid == 0)
+    {
+      element.median = 0;
+      continue;
+    }
+
+    // Zero-based rank of the median among valid values, same as in
+    // MedianBuffer
+    const size_t rank = num_valid / 2;
+
+    // Move to the coarse bin that contains the median
+    const boost::uint16_t* coarse = &coarse_[i * num_coarse_bins_];
+    size_t median_coarse = element.median_coarse;
+    while (element.below_coarse > rank)
+      element.below_coarse -= coarse[--median_coarse];
+    while (element.below_coarse + coarse[median_coarse] <= rank)
+      element.below_coarse += coarse[median_coarse++];
+    if (median_coarse != element.median_coarse)
+    {
+      element.median_coarse = static_cast<boost::uint16_t> (median_coarse);
+      element.median_fine = 0;
+      element.below_fine = 0;
+    }
+
+    // Move to the fine bin that contains the median
+    if (element.slot_coarse[element.median_slot] != median_coarse)
+      selectSlot (i);
+    const boost::uint16_t* fine = &fine_[(i * NUM_FINE_SLOTS + element.median_slot) * num_fine_bins_];
+    const size_t fine_rank = rank - element.below_coarse;
+    while (element.below_fine > fine_rank)
+      element.below_fine -= fine[--element.median_fine];
+    while (element.below_fine + fine[element.median_fine] <= fine_rank)
+      element.below_fine += fine[element.median_fine++];
+
+    element.median = static_cast<boost::uint16_t> (((median_coarse << fine_bits_) | element.median_fine) << quantization_bits_);
+  }
+}
+
+inline void
+pcl::io::HistogramMedianBuffer::selectSlot (size_t idx)
+{
+  Element& element = elements_[idx];
+  for (size_t s = 0; s < NUM_FINE_SLOTS; ++s)
+  {
+    if (element.slot_coarse[s] == element.median_coarse)
+    {
+      element.median_slot = static_cast<boost::uint16_t> (s);
+      return;
+    }
+  }
+
+  // Reuse the slot that did not hold the previous median and collect fine
+  // counts of the new median coarse bin from the window
+  const size_t slot = (element.median_slot + 1) % NUM_FINE_SLOTS;
+  boost::uint16_t* fine = &fine_[(idx * NUM_FINE_SLOTS + slot) * num_fine_bins_];
+  std::fill (fine, fine + num_fine_bins_, 0);
+  for (size_t w = 0; w < window_size_; ++w)
+  {
+    const unsigned short value = data_[w * size_ + idx];
+    if (value == 0)
+      continue;
+    const size_t q = value >> quantization_bits_;
+    if ((q >> fine_bits_) == element.median_coarse)
+      ++fine[q & (num_fine_bins_ - 1)];
+  }
+  element.slot_coarse[slot] = element.median_coarse;
+  element.median_slot = static_cast<boost::uint16_t> (slot);
+}
+
@@ -0,0 +1,252 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef PCL_IO_INTERVAL_RECORDER_H
+#define PCL_IO_INTERVAL_RECORDER_H
+
+#include <cmath>
+#include <algorithm>
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+#include <boost/scoped_array.hpp>
+
+namespace pcl
+{
+
+  namespace io
+  {
+
+    /** Summary of recorded intervals between events, in microseconds. */
+    struct IntervalStatistics
+    {
+      IntervalStatistics ()
+      : num_intervals (0)
+      , mean (0.0)
+      , jitter (0.0)
+      , min (0)
+      , max (0)
+      , frequency (0.0)
+      , num_missed (0)
+      {
+      }
+
+      /// Number of intervals the statistics are computed from
+      size_t num_intervals;
+      double mean;
+      /// Standard deviation of intervals
+      double jitter;
+      boost::uint32_t min;
+      boost::uint32_t max;
+      /// Mean frequency in Hz
+      double frequency;
+      /// Estimated number of events that should have happened within these
+      /// intervals given the expected interval, zero if it is not known
+      size_t num_missed;
+    };
+
+    /** Records intervals between events in a fixed-capacity ring buffer,
+      * without locks.
+      *
+      * There may be a single writer thread that calls record(), and any
+      * number of threads that call getStatistics() at the same time. Neither
+      * of them ever blocks or allocates: readers walk the buffer from the
+      * newest interval back and stop at the first one that the writer has
+      * started to overwrite.
+      *
+      * If the expected interval between events is known (e.g. the frame
+      * rate of a camera), intervals that span several expected intervals are
+      * counted as missed events. */
+    class IntervalRecorder : boost::noncopyable
+    {
+
+      public:
+
+        /** Create a recorder.
+          *
+          * \param[in] capacity number of most recent intervals that are kept */
+        IntervalRecorder (size_t capacity = 64)
+        : capacity_ (std::max<size_t> (capacity, 1))
+        , intervals_ (new boost::atomic<boost::uint32_t>[capacity_])
+        , num_started_ (0)
+        , num_recorded_ (0)
+        , num_missed_ (0)
+        , expected_interval_ (0)
+        , last_time_ (0)
+        , has_last_time_ (false)
+        {
+          for (size_t i = 0; i < capacity_; ++i)
+            intervals_[i].store (0, boost::memory_order_relaxed);
+        }
+
+        /** Notify the recorder that an event occurred.
+          *
+          * Should only be called from one thread at a time.
+          *
+          * \param[in] time time of the event in microseconds. The clock does not
+          * have to be monotonic, but steps back are recorded as zero
+          * intervals. */
+        void
+        record (boost::uint64_t time)
+        {
+          if (!has_last_time_)
+          {
+            last_time_ = time;
+            has_last_time_ = true;
+            return;
+          }
+          const boost::uint64_t interval = time > last_time_ ? time - last_time_ : 0;
+          last_time_ = time;
+          const boost::uint32_t value = static_cast<boost::uint32_t> (std::min<boost::uint64_t> (interval, 0xFFFFFFFF));
+          if (expected_interval_ > 0)
+            num_missed_.fetch_add (countMissed (value, expected_interval_), boost::memory_order_relaxed);
+
+          // Announce the overwrite before writing, so that readers which see
+          // the new value also see that the slot is no longer valid
+          const size_t index = num_recorded_.load (boost::memory_order_relaxed);
+          num_started_.store (index + 1, boost::memory_order_relaxed);
+          boost::atomic_thread_fence (boost::memory_order_release);
+          intervals_[index % capacity_].store (value, boost::memory_order_relaxed);
+          num_recorded_.store (index + 1, boost::memory_order_release);
+        }
+
+        /** Compute statistics over the intervals currently in the buffer.
+          *
+          * Can be called from any number of threads, never blocks and does
+          * not allocate. */
+        IntervalStatistics
+        getStatistics () const
+        {
+          IntervalStatistics stats;
+          const size_t end = num_recorded_.load (boost::memory_order_acquire);
+          const size_t size = std::min (end, capacity_);
+          const boost::uint32_t expected_interval = expected_interval_.load (boost::memory_order_relaxed);
+          double sum = 0.0;
+          double sum_squares = 0.0;
+          // Walk from the newest interval back, the writer overwrites the
+          // oldest ones first
+          for (size_t k = 0; k < size; ++k)
+          {
+            const size_t index = end - 1 - k;
+            const boost::uint32_t interval = intervals_[index % capacity_].load (boost::memory_order_relaxed);
+            boost::atomic_thread_fence (boost::memory_order_acquire);
+            const size_t started = num_started_.load (boost::memory_order_relaxed);
+            // Recorder was reset while reading
+            if (started < end)
+              return (IntervalStatistics ());
+            // Slot is being overwritten, and so are all older ones
+            if (started > index + capacity_)
+              break;
+            sum += interval;
+            sum_squares += static_cast<double> (interval) * interval;
+            stats.min = k == 0 ? interval : std::min (stats.min, interval);
+            stats.max = std::max (stats.max, interval);
+            if (expected_interval > 0)
+              stats.num_missed += countMissed (interval, expected_interval);
+            ++stats.num_intervals;
+          }
+          if (stats.num_intervals == 0)
+            return (stats);
+          stats.mean = sum / stats.num_intervals;
+          stats.jitter = std::sqrt (std::max (sum_squares / stats.num_intervals - stats.mean * stats.mean, 0.0));
+          stats.frequency = stats.mean > 0.0 ? 1.0e+6 / stats.mean : 0.0;
+          return (stats);
+        }
+
+        /** Get the estimated number of missed events since the last reset(),
+          * zero if the expected interval is not known. */
+        inline size_t
+        getNumMissed () const
+        {
+          return (num_missed_.load (boost::memory_order_relaxed));
+        }
+
+        /** Discard all intervals and set the expected interval between events.
+          *
+          * Should not be called concurrently with record().
+          *
+          * \param[in] expected_interval expected interval in microseconds, zero
+          * if unknown */
+        void
+        reset (boost::uint32_t expected_interval = 0)
+        {
+          num_started_.store (0, boost::memory_order_relaxed);
+          num_recorded_.store (0, boost::memory_order_relaxed);
+          num_missed_.store (0, boost::memory_order_relaxed);
+          expected_interval_ = expected_interval;
+          has_last_time_ = false;
+        }
+
+        inline size_t
+        getCapacity () const
+        {
+          return (capacity_);
+        }
+
+      private:
+
+        /* Number of events missed within an interval, i.e. the number of
+         * expected intervals it spans (rounded) minus one. */
+        static size_t
+        countMissed (boost::uint32_t interval, boost::uint32_t expected_interval)
+        {
+          const size_t spans = (interval + expected_interval / 2) / expected_interval;
+          return (spans > 1 ? spans - 1 : 0);
+        }
+
+        const size_t capacity_;
+        boost::scoped_array<boost::atomic<boost::uint32_t> > intervals_;
+
+        /// Number of intervals whose recording started and finished
+        boost::atomic<size_t> num_started_;
+        boost::atomic<size_t> num_recorded_;
+
+        boost::atomic<size_t> num_missed_;
+        boost::atomic<boost::uint32_t> expected_interval_;
+
+        /// Only accessed by the writer
+        boost::uint64_t last_time_;
+        bool has_last_time_;
+
+    };
+
+  }
+
+}
+
+#endif /* PCL_IO_INTERVAL_RECORDER_H */
@@ -0,0 +1,163 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef PCL_IO_LATENCY_RECORDER_H
+#define PCL_IO_LATENCY_RECORDER_H
+
+#include <vector>
+#include <algorithm>
+
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+#include <boost/circular_buffer.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace pcl
+{
+
+  namespace io
+  {
+
+    /** Summary of recorded latencies, in microseconds. */
+    struct LatencyStatistics
+    {
+      LatencyStatistics ()
+      : num_samples (0)
+      , mean (0.0)
+      , p50 (0)
+      , p99 (0)
+      , max (0)
+      {
+      }
+
+      /// Number of samples the statistics are computed from
+      size_t num_samples;
+      double mean;
+      /// Median
+      boost::uint64_t p50;
+      /// 99th percentile
+      boost::uint64_t p99;
+      boost::uint64_t max;
+    };
+
+    /** Keeps the most recent latency samples and summarizes them on demand.
+      *
+      * Recording is a constant-time insertion into a fixed-capacity ring
+      * buffer, so it is cheap enough to do for every frame. Percentiles are
+      * only computed in getStatistics(). Safe to use from several threads. */
+    class LatencyRecorder : boost::noncopyable
+    {
+
+      public:
+
+        /** Create a recorder.
+          *
+          * \param[in] capacity number of most recent samples that are kept */
+        LatencyRecorder (size_t capacity = 1000)
+        : samples_ (std::max<size_t> (capacity, 1))
+        {
+        }
+
+        void
+        record (boost::uint64_t latency)
+        {
+          boost::mutex::scoped_lock lock (mutex_);
+          samples_.push_back (latency);
+        }
+
+        /** Compute statistics over the samples currently in the buffer.
+          *
+          * Percentiles use the nearest-rank definition, i.e. they are always
+          * one of the recorded samples. */
+        LatencyStatistics
+        getStatistics () const
+        {
+          std::vector<boost::uint64_t> samples;
+          {
+            boost::mutex::scoped_lock lock (mutex_);
+            samples.assign (samples_.begin (), samples_.end ());
+          }
+          LatencyStatistics stats;
+          if (samples.empty ())
+            return (stats);
+          std::sort (samples.begin (), samples.end ());
+          double sum = 0.0;
+          for (size_t i = 0; i < samples.size (); ++i)
+            sum += samples[i];
+          stats.num_samples = samples.size ();
+          stats.mean = sum / samples.size ();
+          stats.p50 = samples[getRank (samples.size (), 50)];
+          stats.p99 = samples[getRank (samples.size (), 99)];
+          stats.max = samples.back ();
+          return (stats);
+        }
+
+        /** Discard all samples. */
+        void
+        reset ()
+        {
+          boost::mutex::scoped_lock lock (mutex_);
+          samples_.clear ();
+        }
+
+        inline size_t
+        getCapacity () const
+        {
+          return (samples_.capacity ());
+        }
+
+      private:
+
+        /* Index of the nearest-rank percentile in a sorted array. */
+        static size_t
+        getRank (size_t size, size_t percent)
+        {
+          size_t rank = (percent * size + 99) / 100;
+          return (rank > 0 ? rank - 1 : 0);
+        }
+
+        boost::circular_buffer<boost::uint64_t> samples_;
+        mutable boost::mutex mutex_;
+
+    };
+
+  }
+
+}
+
+#endif /* PCL_IO_LATENCY_RECORDER_H */
+
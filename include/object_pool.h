@@ -0,0 +1,261 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef PCL_IO_OBJECT_POOL_H
+#define PCL_IO_OBJECT_POOL_H
+
+#include <vector>
+
+#include <boost/utility.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace pcl
+{
+
+  namespace io
+  {
+
+    /** A pool of reusable heap objects.
+      *
+      * Objects are handed out as shared pointers with a custom deleter that
+      * returns them to the pool once the last reference is dropped, so that
+      * large objects (such as point clouds) can be recycled between frames
+      * instead of being allocated and freed every time.
+      *
+      * The pool grows on demand up to a maximum size. When all pooled objects
+      * are in use, acquire() creates extra objects that are not pooled and
+      * are deleted as usual when released. Objects may be released from any
+      * thread and may outlive the pool. */
+    template <typename T>
+    class ObjectPool : boost::noncopyable
+    {
+
+      public:
+
+        typedef boost::shared_ptr<ObjectPool<T> > Ptr;
+
+        /// Function that creates new objects
+        typedef boost::function<T* ()> Factory;
+
+        /** Create a pool.
+          *
+          * \param[in] factory function that creates new objects
+          * \param[in] max_size maximum number of objects owned by the pool,
+          * zero disables pooling */
+        ObjectPool (const Factory& factory, size_t max_size)
+        : state_ (new State (factory, max_size))
+        {
+        }
+
+        ~ObjectPool ()
+        {
+          state_->close ();
+        }
+
+        /** Get an object from the pool, creating a new one if there are no
+          * free objects.
+          *
+          * Objects are not reset, they come back in the state they were in
+          * when released. */
+        boost::shared_ptr<T>
+        acquire ()
+        {
+          T* object = 0;
+          bool pooled = false;
+          {
+            boost::mutex::scoped_lock lock (state_->mutex);
+            if (!state_->free.empty ())
+            {
+              object = state_->free.back ();
+              state_->free.pop_back ();
+              pooled = true;
+            }
+            else if (state_->num_allocated < state_->max_size)
+            {
+              ++state_->num_allocated;
+              pooled = true;
+            }
+          }
+          if (!object)
+          {
+            try
+            {
+              object = state_->factory ();
+            }
+            catch (...)
+            {
+              // Give back the slot reserved for the object
+              if (pooled)
+              {
+                boost::mutex::scoped_lock lock (state_->mutex);
+                --state_->num_allocated;
+              }
+              throw;
+            }
+          }
+          if (pooled)
+            return (boost::shared_ptr<T> (object, Deleter (state_)));
+          return (boost::shared_ptr<T> (object));
+        }
+
+        /** Set the maximum number of objects owned by the pool.
+          *
+          * If the pool is shrunk, surplus free objects are deleted right
+          * away, and surplus objects in use are deleted when released. */
+        void
+        setMaxSize (size_t max_size)
+        {
+          std::vector<T*> surplus;
+          {
+            boost::mutex::scoped_lock lock (state_->mutex);
+            state_->max_size = max_size;
+            state_->free.reserve (max_size);
+            while (state_->num_allocated > max_size && !state_->free.empty ())
+            {
+              surplus.push_back (state_->free.back ());
+              state_->free.pop_back ();
+              --state_->num_allocated;
+            }
+          }
+          for (size_t i = 0; i < surplus.size (); ++i)
+            delete surplus[i];
+        }
+
+        size_t
+        getMaxSize () const
+        {
+          boost::mutex::scoped_lock lock (state_->mutex);
+          return (state_->max_size);
+        }
+
+        /** Get the number of objects owned by the pool, both free and in
+          * use. */
+        size_t
+        getNumAllocated () const
+        {
+          boost::mutex::scoped_lock lock (state_->mutex);
+          return (state_->num_allocated);
+        }
+
+        /** Get the number of free objects that are ready to be reused. */
+        size_t
+        getNumFree () const
+        {
+          boost::mutex::scoped_lock lock (state_->mutex);
+          return (state_->free.size ());
+        }
+
+      private:
+
+        /* State shared between the pool and the deleters of the objects it
+         * handed out, which keeps it alive as long as any of them is. */
+        struct State
+        {
+          State (const Factory& factory, size_t max_size)
+          : factory (factory)
+          , max_size (max_size)
+          , num_allocated (0)
+          , closed (false)
+          {
+            free.reserve (max_size);
+          }
+
+          ~State ()
+          {
+            for (size_t i = 0; i < free.size (); ++i)
+              delete free[i];
+          }
+
+          /* Take an object back, or delete it if the pool is closed or
+           * over its maximum size. */
+          void
+          release (T* object)
+          {
+            {
+              boost::mutex::scoped_lock lock (mutex);
+              if (!closed && num_allocated <= max_size)
+              {
+                free.push_back (object);
+                return;
+              }
+              --num_allocated;
+            }
+            delete object;
+          }
+
+          /* Delete free objects and stop taking objects back. */
+          void
+          close ()
+          {
+            std::vector<T*> objects;
+            {
+              boost::mutex::scoped_lock lock (mutex);
+              closed = true;
+              objects.swap (free);
+              num_allocated -= objects.size ();
+            }
+            for (size_t i = 0; i < objects.size (); ++i)
+              delete objects[i];
+          }
+
+          Factory factory;
+          size_t max_size;
+          size_t num_allocated;
+          bool closed;
+          std::vector<T*> free;
+          mutable boost::mutex mutex;
+        };
+
+        struct Deleter
+        {
+          Deleter (const boost::shared_ptr<State>& state) : state_ (state) { }
+          void operator() (T* object) { state_->release (object); }
+          boost::shared_ptr<State> state_;
+        };
+
+        boost::shared_ptr<State> state_;
+
+    };
+
+  }
+
+}
+
+#endif /* PCL_IO_OBJECT_POOL_H */
+
@@ -0,0 +1,278 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef PCL_IO_REAL_SENSE_DECIMATION_H
+#define PCL_IO_REAL_SENSE_DECIMATION_H
+
+#include <cstring>
+#include <algorithm>
+
+#include <boost/cstdint.hpp>
+
+#include "buffers.h"
+#include "real_sense/ray_table.h"
+
+namespace pcl
+{
+
+  namespace io
+  {
+
+    namespace real_sense
+    {
+
+      /** How blocks of factor x factor depth pixels are reduced to one. */
+      enum DecimationMethod
+      {
+        /// Keep the top-left pixel of each block
+        DECIMATION_STRIDE = 0,
+        /// Median of the valid (non-zero) pixels of each block
+        DECIMATION_MEDIAN = 1,
+        /// Mean of the valid (non-zero) pixels of each block
+        DECIMATION_MEAN = 2,
+      };
+
+      /// Largest factor supported by binning (DECIMATION_MEDIAN and
+      /// DECIMATION_MEAN)
+      const unsigned int MAX_BINNING_DECIMATION_FACTOR = 4;
+
+      /** Get the pixel of a block (along both axes) that stands for the whole
+        * block when sampling other per-pixel data, such as registered color,
+        * alongside decimated depth. */
+      inline unsigned int
+      getDecimationOffset (unsigned int factor, DecimationMethod method)
+      {
+        return (method == DECIMATION_STRIDE ? 0 : factor / 2);
+      }
+
+      /** Compute intrinsics of a decimated image.
+        *
+        * Pixel (u, v) of a decimated image corresponds to the center of a
+        * block, i.e. to (factor * u + c, factor * v + c) in the original
+        * image, where c is 0 for DECIMATION_STRIDE and (factor - 1) / 2 for
+        * binning. Distortion is defined in normalized coordinates and does
+        * not change. */
+      inline CameraIntrinsics
+      decimateIntrinsics (const CameraIntrinsics& intrinsics, unsigned int factor, DecimationMethod method)
+      {
+        const float c = method == DECIMATION_STRIDE ? 0.0f : 0.5f * (factor - 1);
+        CameraIntrinsics result (intrinsics);
+        result.fx = intrinsics.fx / factor;
+        result.fy = intrinsics.fy / factor;
+        result.cx = (intrinsics.cx - c) / factor;
+        result.cy = (intrinsics.cy - c) / factor;
+        return (result);
+      }
+
+      /** Take one pixel of every factor x factor block of an image.
+        *
+        * Output has (width / factor) x (height / factor) pixels, partial
+        * blocks at the right and bottom borders are dropped.
+        *
+        * \param[in] offset position of the pixel within a block
+        * \param[in] step distance between input rows in pixels, zero means
+        * \a width (a larger step allows to process a region of a larger
+        * image) */
+      template <typename T> void
+      subsample (const T* input,
+                 unsigned int width,
+                 unsigned int height,
+                 unsigned int factor,
+                 unsigned int offset,
+                 T* output,
+                 unsigned int step = 0)
+      {
+        const unsigned int out_width = width / factor;
+        const unsigned int out_height = height / factor;
+        if (step == 0)
+          step = width;
+        for (unsigned int v = 0; v < out_height; ++v)
+        {
+          const T* row = input + (v * factor + offset) * step + offset;
+          for (unsigned int u = 0; u < out_width; ++u)
+            *output++ = row[u * factor];
+        }
+      }
+
+      namespace detail
+      {
+
+        /* Same pixel of a number of consecutive blocks. Binning works on
+         * lanes rather than on individual blocks, so that the compiler can
+         * vectorize it across blocks. */
+        const unsigned int LANE_SIZE = 64;
+
+        struct Lane
+        {
+          boost::uint16_t v[LANE_SIZE];
+        };
+
+        struct LaneMinMax
+        {
+          static inline void
+          exchange (Lane& a, Lane& b)
+          {
+            for (unsigned int i = 0; i < LANE_SIZE; ++i)
+            {
+              const boost::uint16_t min = std::min (a.v[i], b.v[i]);
+              b.v[i] = std::max (a.v[i], b.v[i]);
+              a.v[i] = min;
+            }
+          }
+        };
+
+        template <unsigned int N> inline void
+        binMean (const Lane* lanes, unsigned int n, boost::uint16_t* output)
+        {
+          float sum[LANE_SIZE];
+          float count[LANE_SIZE];
+          for (unsigned int i = 0; i < LANE_SIZE; ++i)
+            sum[i] = count[i] = 0.0f;
+          for (unsigned int k = 0; k < N; ++k)
+            for (unsigned int i = 0; i < LANE_SIZE; ++i)
+            {
+              sum[i] += lanes[k].v[i];
+              count[i] += lanes[k].v[i] != 0;
+            }
+          // Sums are exact in single precision, and so is rounding of the
+          // quotient for block sizes up to 16
+          for (unsigned int i = 0; i < n; ++i)
+            output[i] = count[i] > 0.0f ? static_cast<boost::uint16_t> (sum[i] / count[i] + 0.5f) : 0;
+        }
+
+        template <unsigned int N> inline void
+        binMedian (Lane* lanes, unsigned int n, boost::uint16_t* output)
+        {
+          // Subtracting one maps invalid (zero) depth to the largest value, so
+          // that after sorting valid depths come first, and keeps the order
+          // of valid depths
+          boost::uint16_t count[LANE_SIZE];
+          for (unsigned int i = 0; i < LANE_SIZE; ++i)
+            count[i] = 0;
+          for (unsigned int k = 0; k < N; ++k)
+            for (unsigned int i = 0; i < LANE_SIZE; ++i)
+            {
+              count[i] += lanes[k].v[i] != 0;
+              lanes[k].v[i] -= 1;
+            }
+          pcl::io::detail::SortingNetwork<N, 0, 0>::template sort<LaneMinMax> (lanes);
+          // A block without valid depths gives 0xFFFF + 1 = 0
+          for (unsigned int i = 0; i < n; ++i)
+            output[i] = static_cast<boost::uint16_t> (lanes[count[i] ? (count[i] - 1) / 2 : 0].v[i] + 1);
+        }
+
+        template <unsigned int Factor> void
+        binDepth (const boost::uint16_t* input,
+                  unsigned int width,
+                  unsigned int height,
+                  unsigned int step,
+                  DecimationMethod method,
+                  boost::uint16_t* output)
+        {
+          const unsigned int N = Factor * Factor;
+          const unsigned int out_width = width / Factor;
+          const unsigned int out_height = height / Factor;
+          // Lanes of a partial chunk are processed in full, so they should
+          // hold some values
+          Lane lanes[N];
+          memset (lanes, 0, sizeof (lanes));
+          for (unsigned int v = 0; v < out_height; ++v)
+            for (unsigned int u = 0; u < out_width; u += LANE_SIZE)
+            {
+              const unsigned int n = std::min (LANE_SIZE, out_width - u);
+              for (unsigned int j = 0; j < Factor; ++j)
+                for (unsigned int i = 0; i < Factor; ++i)
+                {
+                  const boost::uint16_t* p = input + (v * Factor + j) * step + u * Factor + i;
+                  for (unsigned int l = 0; l < n; ++l)
+                    lanes[j * Factor + i].v[l] = p[l * Factor];
+                }
+              if (method == DECIMATION_MEAN)
+                binMean<N> (lanes, n, output + v * out_width + u);
+              else
+                binMedian<N> (lanes, n, output + v * out_width + u);
+            }
+        }
+
+      }
+
+      /** Decimate a depth image (in millimeters, zero meaning invalid) by
+        * an integer factor.
+        *
+        * Binning only takes valid pixels into account, a block without valid
+        * pixels stays invalid. For an even number of valid pixels median
+        * binning takes the lower of the two middle values, so the result is
+        * always one of the measured depths. Binning supports factors 2, 3
+        * and 4 (up to MAX_BINNING_DECIMATION_FACTOR), other factors fall
+        * back to DECIMATION_STRIDE.
+        *
+        * Output has (width / factor) x (height / factor) pixels. Factor 1
+        * copies the image (or a region of it, see \a step).
+        *
+        * \param[in] step distance between input rows in pixels, zero means
+        * \a width */
+      inline void
+      decimateDepth (const boost::uint16_t* input,
+                     unsigned int width,
+                     unsigned int height,
+                     unsigned int factor,
+                     DecimationMethod method,
+                     boost::uint16_t* output,
+                     unsigned int step = 0)
+      {
+        if (step == 0)
+          step = width;
+        if (method != DECIMATION_STRIDE)
+        {
+          switch (factor)
+          {
+            case 2: detail::binDepth<2> (input, width, height, step, method, output); return;
+            case 3: detail::binDepth<3> (input, width, height, step, method, output); return;
+            case 4: detail::binDepth<4> (input, width, height, step, method, output); return;
+          }
+        }
+        subsample (input, width, height, factor, 0, output, step);
+      }
+
+    }
+
+  }
+
+}
+
+#endif /* PCL_IO_REAL_SENSE_DECIMATION_H */
+
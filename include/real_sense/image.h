@@ -0,0 +1,168 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef PCL_IO_REAL_SENSE_IMAGE_H
+#define PCL_IO_REAL_SENSE_IMAGE_H
+
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace pcl
+{
+
+  namespace io
+  {
+
+    namespace real_sense
+    {
+
+      /** A read-only view of image data owned by someone else.
+        *
+        * The image keeps a handle to the owner of the data, so the data stays
+        * valid for as long as the image exists. For images delivered by
+        * RealSenseGrabber the data is the memory of the SDK image, and access
+        * to it is released once the last reference to the image is dropped.
+        *
+        * Rows may be padded, use getStride() to step between them. */
+      template <typename PixelT>
+      class Image : boost::noncopyable
+      {
+
+        public:
+
+          typedef boost::shared_ptr<Image<PixelT> > Ptr;
+          typedef boost::shared_ptr<const Image<PixelT> > ConstPtr;
+
+          /** Create an image.
+            *
+            * \param[in] data pointer to the first pixel
+            * \param[in] width, height image size in pixels
+            * \param[in] stride distance between rows in bytes
+            * \param[in] timestamp capture time in microseconds since the Unix
+              * epoch
+            * \param[in] handle keeps \a data valid while the image exists */
+          Image (const PixelT* data,
+                 unsigned int width,
+                 unsigned int height,
+                 unsigned int stride,
+                 boost::uint64_t timestamp,
+                 const boost::shared_ptr<void>& handle)
+          : data_ (data)
+          , width_ (width)
+          , height_ (height)
+          , stride_ (stride)
+          , timestamp_ (timestamp)
+          , handle_ (handle)
+          {
+          }
+
+          inline const PixelT*
+          getData () const
+          {
+            return (data_);
+          }
+
+          inline const PixelT*
+          getRow (unsigned int v) const
+          {
+            return (reinterpret_cast<const PixelT*> (reinterpret_cast<const unsigned char*> (data_) + v * stride_));
+          }
+
+          inline const PixelT&
+          at (unsigned int u, unsigned int v) const
+          {
+            return (getRow (v)[u]);
+          }
+
+          inline unsigned int
+          getWidth () const
+          {
+            return (width_);
+          }
+
+          inline unsigned int
+          getHeight () const
+          {
+            return (height_);
+          }
+
+          inline unsigned int
+          getStride () const
+          {
+            return (stride_);
+          }
+
+          /** Check whether rows are stored without padding, i.e. the data can
+            * be treated as a contiguous array of width * height pixels. */
+          inline bool
+          isContiguous () const
+          {
+            return (stride_ == width_ * sizeof (PixelT));
+          }
+
+          inline boost::uint64_t
+          getTimestamp () const
+          {
+            return (timestamp_);
+          }
+
+        private:
+
+          const PixelT* data_;
+          unsigned int width_;
+          unsigned int height_;
+          unsigned int stride_;
+          boost::uint64_t timestamp_;
+          boost::shared_ptr<void> handle_;
+
+      };
+
+      /// Depth image, in millimeters (zero means no measurement)
+      typedef Image<boost::uint16_t> DepthImage;
+
+      /// Color image, 32-bit BGRA pixels (same layout as PCL rgba field)
+      typedef Image<boost::uint32_t> ColorImage;
+
+    }
+
+  }
+
+}
+
+#endif /* PCL_IO_REAL_SENSE_IMAGE_H */
+
@@ -0,0 +1,239 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef PCL_IO_REAL_SENSE_POINT_CONVERSION_H
+#define PCL_IO_REAL_SENSE_POINT_CONVERSION_H
+
+#include <limits>
+#include <cstddef>
+
+#if defined (__x86_64__) || defined (__i386__) || defined (_M_X64) || defined (_M_IX86)
+  #define PCL_IO_POINT_CONVERSION_X86
+  #include <immintrin.h>
+  #if defined (_MSC_VER)
+    #include <intrin.h>
+  #endif
+#endif
+
+/* Kernels for different instruction sets are compiled into the same binary
+ * and selected at runtime, so GCC and Clang need to be told which
+ * instructions each function may use. MSVC allows intrinsics everywhere. */
+#if defined (__GNUC__)
+  #define PCL_IO_TARGET(isa) __attribute__ ((target (isa)))
+#else
+  #define PCL_IO_TARGET(isa)
+#endif
+
+namespace pcl
+{
+
+  namespace io
+  {
+
+    namespace real_sense
+    {
+
+      /** Implementations of the vertex conversion kernel. */
+      enum ConversionKernel
+      {
+        SCALAR_KERNEL = 0,
+        SSE4_KERNEL = 1,
+        AVX2_KERNEL = 2,
+      };
+
+      namespace detail
+      {
+
+        template <typename PointT> inline void
+        convertVerticesScalar (const float* vertices, PointT* points, size_t begin, size_t end, float scale)
+        {
+          for (size_t i = begin; i < end; ++i)
+          {
+            const float* v = vertices + 3 * i;
+            float* p = points[i].data;
+            if (v[2] == 0)
+            {
+              p[0] = p[1] = p[2] = std::numeric_limits<float>::quiet_NaN ();
+            }
+            else
+            {
+              p[0] = v[0] * scale;
+              p[1] = v[1] * scale;
+              p[2] = v[2] * scale;
+            }
+            p[3] = 1.0f;
+          }
+        }
+
+#ifdef PCL_IO_POINT_CONVERSION_X86
+
+        template <typename PointT> PCL_IO_TARGET ("sse4.1") void
+        convertVerticesSSE4 (const float* vertices, PointT* points, size_t size, float scale)
+        {
+          const __m128 scale4 = _mm_set1_ps (scale);
+          const __m128 nan = _mm_set1_ps (std::numeric_limits<float>::quiet_NaN ());
+          const __m128 one = _mm_set1_ps (1.0f);
+          const __m128 zero = _mm_setzero_ps ();
+          size_t i = 0;
+          // Every load reads one float past the vertex, so the last vertex is
+          // left for the scalar loop
+          for (; i + 1 < size; ++i)
+          {
+            __m128 v = _mm_loadu_ps (vertices + 3 * i);
+            __m128 invalid = _mm_cmpeq_ps (_mm_shuffle_ps (v, v, _MM_SHUFFLE (2, 2, 2, 2)), zero);
+            __m128 p = _mm_blendv_ps (_mm_mul_ps (v, scale4), nan, invalid);
+            _mm_storeu_ps (points[i].data, _mm_blend_ps (p, one, 0x8));
+          }
+          convertVerticesScalar (vertices, points, i, size, scale);
+        }
+
+        template <typename PointT> PCL_IO_TARGET ("avx2") void
+        convertVerticesAVX2 (const float* vertices, PointT* points, size_t size, float scale)
+        {
+          const __m256 scale8 = _mm256_set1_ps (scale);
+          const __m256 nan = _mm256_set1_ps (std::numeric_limits<float>::quiet_NaN ());
+          const __m256 one = _mm256_set1_ps (1.0f);
+          const __m256 zero = _mm256_setzero_ps ();
+          size_t i = 0;
+          // Process two vertices at a time, one per 128-bit lane
+          for (; i + 3 <= size; i += 2)
+          {
+            __m256 v = _mm256_insertf128_ps (_mm256_castps128_ps256 (_mm_loadu_ps (vertices + 3 * i)),
+                                             _mm_loadu_ps (vertices + 3 * i + 3), 1);
+            __m256 invalid = _mm256_cmp_ps (_mm256_permute_ps (v, _MM_SHUFFLE (2, 2, 2, 2)), zero, _CMP_EQ_OQ);
+            __m256 p = _mm256_blendv_ps (_mm256_mul_ps (v, scale8), nan, invalid);
+            p = _mm256_blend_ps (p, one, 0x88);
+            _mm_storeu_ps (points[i].data, _mm256_castps256_ps128 (p));
+            _mm_storeu_ps (points[i + 1].data, _mm256_extractf128_ps (p, 1));
+          }
+          convertVerticesScalar (vertices, points, i, size, scale);
+        }
+
+#endif
+
+        inline ConversionKernel
+        detectConversionKernel ()
+        {
+#if defined (PCL_IO_POINT_CONVERSION_X86) && defined (__GNUC__)
+          __builtin_cpu_init ();
+          if (__builtin_cpu_supports ("avx2"))
+            return (AVX2_KERNEL);
+          if (__builtin_cpu_supports ("sse4.1"))
+            return (SSE4_KERNEL);
+#elif defined (PCL_IO_POINT_CONVERSION_X86) && defined (_MSC_VER)
+          int info[4];
+          __cpuid (info, 0);
+          const int max_leaf = info[0];
+          __cpuid (info, 1);
+          const bool sse41 = (info[2] & (1 << 19)) != 0;
+          // AVX state has to be enabled by the OS as well
+          const bool avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv (0) & 6) == 6;
+          if (avx && max_leaf >= 7)
+          {
+            __cpuidex (info, 7, 0);
+            if (info[1] & (1 << 5))
+              return (AVX2_KERNEL);
+          }
+          if (sse41)
+            return (SSE4_KERNEL);
+#endif
+          return (SCALAR_KERNEL);
+        }
+
+      }
+
+      /** Get the fastest vertex conversion kernel supported by the CPU. */
+      inline ConversionKernel
+      getBestConversionKernel ()
+      {
+        static const ConversionKernel kernel = detail::detectConversionKernel ();
+        return (kernel);
+      }
+
+      /** Check if a vertex conversion kernel is supported by the CPU. */
+      inline bool
+      isConversionKernelSupported (ConversionKernel kernel)
+      {
+        return (kernel <= getBestConversionKernel ());
+      }
+
+      /** Convert vertices computed by the SDK into PCL points.
+        *
+        * Vertices are scaled by \a scale (default: millimeters to meters),
+        * vertices with zero depth become points with NaN coordinates. The
+        * padding element of each point is set to 1.
+        *
+        * \param[in] vertices array of \a size (x, y, z) triplets, e.g.
+        * PXCPoint3DF32 data
+        * \param[out] points output points, PointT should have a float data[4]
+        * member that holds x, y and z (e.g. pcl::PointXYZ or
+        * pcl::PointXYZRGBA)
+        * \param[in] size number of vertices
+        * \param[in] scale factor to convert vertex coordinates
+        * \param[in] kernel implementation to use, should be supported by the
+        * CPU (all of them produce exactly the same result) */
+      template <typename PointT> void
+      convertVertices (const float* vertices,
+                       PointT* points,
+                       size_t size,
+                       float scale = 0.001f,
+                       ConversionKernel kernel = getBestConversionKernel ())
+      {
+        switch (kernel)
+        {
+#ifdef PCL_IO_POINT_CONVERSION_X86
+          case AVX2_KERNEL:
+            detail::convertVerticesAVX2 (vertices, points, size, scale);
+            break;
+          case SSE4_KERNEL:
+            detail::convertVerticesSSE4 (vertices, points, size, scale);
+            break;
+#endif
+          default:
+            detail::convertVerticesScalar (vertices, points, 0, size, scale);
+            break;
+        }
+      }
+
+    }
+
+  }
+
+}
+
+#endif /* PCL_IO_REAL_SENSE_POINT_CONVERSION_H */
+
@@ -0,0 +1,383 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef PCL_IO_REAL_SENSE_RAY_TABLE_H
+#define PCL_IO_REAL_SENSE_RAY_TABLE_H
+
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define PCL_IO_RAY_TABLE_SSE2
+  #include <emmintrin.h>
+#endif
+
+namespace pcl
+{
+
+  namespace io
+  {
+
+    namespace real_sense
+    {
+
+      /** Intrinsic parameters of a camera stream.
+        *
+        * Follow the layout of PXCCalibration::StreamCalibration: focal
+        * length and principal point are in pixels, distortion coefficients
+        * are those of the Brown-Conrady model (k1, k2, k3 and p1, p2). */
+      struct CameraIntrinsics
+      {
+        CameraIntrinsics (float fx = 1.0f, float fy = 1.0f, float cx = 0.0f, float cy = 0.0f)
+        : fx (fx), fy (fy), cx (cx), cy (cy)
+        {
+          radial_distortion[0] = radial_distortion[1] = radial_distortion[2] = 0.0f;
+          tangential_distortion[0] = tangential_distortion[1] = 0.0f;
+        }
+
+        float fx, fy;
+        float cx, cy;
+        float radial_distortion[3];
+        float tangential_distortion[2];
+      };
+
+      /** A table of per-pixel rays for projecting depth images into 3D.
+        *
+        * For every pixel (u, v) the table stores the undistorted normalized
+        * image coordinates (x, y), so that the 3D point corresponding to
+        * depth z is simply (x * z, y * z, z). Building the table inverts the
+        * lens distortion model, which is expensive, but only has to be done
+        * once per stream configuration; projecting a frame afterwards is a
+        * single multiplication per coordinate.
+        *
+        * Rays are stored as 4-vectors (x, y, 1, 0) to match the padded layout
+        * of PCL points. */
+      class RayTable
+      {
+
+        public:
+
+          typedef boost::shared_ptr<RayTable> Ptr;
+
+          RayTable (size_t width, size_t height, const CameraIntrinsics& intrinsics)
+          : width_ (width)
+          , height_ (height)
+          , intrinsics_ (intrinsics)
+          , rays_ (width * height * 4)
+          , min_depth_ (1)
+          , max_depth_ (std::numeric_limits<unsigned short>::max ())
+          {
+            for (size_t v = 0; v < height_; ++v)
+              for (size_t u = 0; u < width_; ++u)
+              {
+                float* ray = &rays_[(v * width_ + u) * 4];
+                undistort (intrinsics_, (u - intrinsics_.cx) / intrinsics_.fx, (v - intrinsics_.cy) / intrinsics_.fy, ray[0], ray[1]);
+                ray[2] = 1.0f;
+                ray[3] = 0.0f;
+              }
+          }
+
+          inline size_t
+          getWidth () const
+          {
+            return (width_);
+          }
+
+          inline size_t
+          getHeight () const
+          {
+            return (height_);
+          }
+
+          inline const CameraIntrinsics&
+          getIntrinsics () const
+          {
+            return (intrinsics_);
+          }
+
+          /** Set the range of valid depth values (inclusive, in the units of
+            * depth images), depth outside of it produces points with NaN
+            * coordinates.
+            *
+            * By default only zero depth is invalid. A minimum of zero is
+            * treated as one, zero depth is always invalid. */
+          inline void
+          setDepthRange (unsigned short min_depth, unsigned short max_depth)
+          {
+            min_depth_ = std::max<unsigned short> (min_depth, 1);
+            max_depth_ = max_depth;
+          }
+
+          inline unsigned short
+          getMinDepth () const
+          {
+            return (min_depth_);
+          }
+
+          inline unsigned short
+          getMaxDepth () const
+          {
+            return (max_depth_);
+          }
+
+          /** Get the ray (x, y, 1, 0) of a pixel. */
+          inline const float*
+          getRay (size_t u, size_t v) const
+          {
+            return (&rays_[(v * width_ + u) * 4]);
+          }
+
+          /** Project a depth image into 3D points.
+            *
+            * Pixels with zero depth (or depth outside of the valid range, see
+            * setDepthRange()) produce points with NaN coordinates.
+            *
+            * \param[in] depth depth image with getWidth() * getHeight()
+            * elements, in row-major order
+            * \param[out] points output points (the same number as depth
+            * pixels), PointT should have a float data[4] member that holds
+            * x, y and z (e.g. pcl::PointXYZ or pcl::PointXYZRGBA)
+            * \param[in] scale factor to convert depth values to the units of
+            * output coordinates (default: millimeters to meters) */
+          template <typename PointT> void
+          project (const unsigned short* depth, PointT* points, float scale = 0.001f) const
+          {
+            dispatch (depth, static_cast<const boost::uint32_t*> (0), points, static_cast<NullPoint*> (0), scale);
+          }
+
+          /** Project a depth image into colored 3D points.
+            *
+            * Same as above, but also fills the rgba member of the output
+            * points from a color image registered to the depth image. The
+            * rgba member is assumed to be followed by padding up to the size
+            * of 16 bytes, as in pcl::PointXYZRGBA. */
+          template <typename PointT> void
+          project (const unsigned short* depth, const boost::uint32_t* color, PointT* colored_points, float scale = 0.001f) const
+          {
+            dispatch (depth, color, static_cast<NullPoint*> (0), colored_points, scale);
+          }
+
+          /** Project a depth image into both uncolored and colored 3D points
+            * in a single pass. */
+          template <typename PointT, typename PointRGBT> void
+          project (const unsigned short* depth, const boost::uint32_t* color, PointT* points, PointRGBT* colored_points, float scale = 0.001f) const
+          {
+            dispatch (depth, color, points, colored_points, scale);
+          }
+
+          /** Apply the distortion model to normalized image coordinates. */
+          static void
+          distort (const CameraIntrinsics& intrinsics, double x, double y, double& xd, double& yd)
+          {
+            const float* k = intrinsics.radial_distortion;
+            const float* p = intrinsics.tangential_distortion;
+            double r2 = x * x + y * y;
+            double radial = 1.0 + r2 * (k[0] + r2 * (k[1] + r2 * k[2]));
+            xd = x * radial + 2.0 * p[0] * x * y + p[1] * (r2 + 2.0 * x * x);
+            yd = y * radial + p[0] * (r2 + 2.0 * y * y) + 2.0 * p[1] * x * y;
+          }
+
+          /** Invert the distortion model with fixed-point iteration. */
+          static void
+          undistort (const CameraIntrinsics& intrinsics, double xd, double yd, float& x, float& y)
+          {
+            const float* k = intrinsics.radial_distortion;
+            const float* p = intrinsics.tangential_distortion;
+            double xu = xd;
+            double yu = yd;
+            for (size_t i = 0; i < 20; ++i)
+            {
+              double r2 = xu * xu + yu * yu;
+              double radial = 1.0 + r2 * (k[0] + r2 * (k[1] + r2 * k[2]));
+              double dx = 2.0 * p[0] * xu * yu + p[1] * (r2 + 2.0 * xu * xu);
+              double dy = p[0] * (r2 + 2.0 * yu * yu) + 2.0 * p[1] * xu * yu;
+              xu = (xd - dx) / radial;
+              yu = (yd - dy) / radial;
+            }
+            x = static_cast<float> (xu);
+            y = static_cast<float> (yu);
+          }
+
+        private:
+
+          /* Placeholder point type for outputs that are not requested. */
+          struct NullPoint
+          {
+            float data[4];
+            boost::uint32_t rgba;
+          };
+
+          /* Run the projection kernel. Non-temporal stores are used when
+           * all outputs are aligned and too large to stay in a typical last
+           * level cache anyway; for smaller outputs regular stores are faster
+           * because subscribers find the points in the cache. */
+          template <typename PointT, typename PointRGBT> void
+          dispatch (const unsigned short* depth, const boost::uint32_t* color, PointT* points, PointRGBT* colored_points, float scale) const
+          {
+            const size_t output_size = width_ * height_ * ((points ? sizeof (PointT) : 0) + (colored_points ? sizeof (PointRGBT) : 0));
+            if (output_size > STREAMING_THRESHOLD && isAligned (points) && isAligned (colored_points))
+              projectKernel<true> (depth, color, points, colored_points, scale);
+            else
+              projectKernel<false> (depth, color, points, colored_points, scale);
+          }
+
+          /* Project depth into points and/or colored points (null pointers
+           * mark outputs that are not requested). */
+          template <bool Stream, typename PointT, typename PointRGBT> void
+          projectKernel (const unsigned short* depth, const boost::uint32_t* color, PointT* points, PointRGBT* colored_points, float scale) const
+          {
+            const size_t size = width_ * height_;
+            const float* ray = &rays_[0];
+            size_t i = 0;
+#ifdef PCL_IO_RAY_TABLE_SSE2
+            const __m128 nan = _mm_set1_ps (std::numeric_limits<float>::quiet_NaN ());
+            const __m128 xyz_mask = _mm_castsi128_ps (_mm_set_epi32 (0, -1, -1, -1));
+            const __m128 w = _mm_set_ps (1.0f, 0.0f, 0.0f, 0.0f);
+            const __m128 scale4 = _mm_set1_ps (scale);
+            const __m128 min_depth = _mm_set1_ps (min_depth_);
+            const __m128 max_depth = _mm_set1_ps (max_depth_);
+            const __m128i zero = _mm_setzero_si128 ();
+            for (; i + 4 <= size; i += 4, ray += 16)
+            {
+              // Convert four depth values to floats and replace zeros (and
+              // out of range values) with NaN
+              __m128i d = _mm_loadl_epi64 (reinterpret_cast<const __m128i*> (depth + i));
+              __m128 z = _mm_cvtepi32_ps (_mm_unpacklo_epi16 (d, zero));
+              __m128 invalid = _mm_or_ps (_mm_cmplt_ps (z, min_depth), _mm_cmpgt_ps (z, max_depth));
+              z = _mm_mul_ps (z, scale4);
+              z = _mm_or_ps (_mm_and_ps (invalid, nan), _mm_andnot_ps (invalid, z));
+              // Multiply every ray by its depth, then put 1 into the padding
+              __m128 p[4];
+              p[0] = _mm_mul_ps (_mm_loadu_ps (ray + 0), _mm_shuffle_ps (z, z, _MM_SHUFFLE (0, 0, 0, 0)));
+              p[1] = _mm_mul_ps (_mm_loadu_ps (ray + 4), _mm_shuffle_ps (z, z, _MM_SHUFFLE (1, 1, 1, 1)));
+              p[2] = _mm_mul_ps (_mm_loadu_ps (ray + 8), _mm_shuffle_ps (z, z, _MM_SHUFFLE (2, 2, 2, 2)));
+              p[3] = _mm_mul_ps (_mm_loadu_ps (ray + 12), _mm_shuffle_ps (z, z, _MM_SHUFFLE (3, 3, 3, 3)));
+              for (size_t k = 0; k < 4; ++k)
+                p[k] = _mm_or_ps (_mm_and_ps (p[k], xyz_mask), w);
+              if (points)
+                for (size_t k = 0; k < 4; ++k)
+                  store<Stream> (points[i + k].data, p[k]);
+              if (colored_points)
+                for (size_t k = 0; k < 4; ++k)
+                {
+                  store<Stream> (colored_points[i + k].data, p[k]);
+                  store<Stream> (&colored_points[i + k].rgba, _mm_cvtsi32_si128 (color[i + k]));
+                }
+            }
+            if (Stream)
+              _mm_sfence ();
+#endif
+            for (; i < size; ++i, ray += 4)
+            {
+              const unsigned short d = depth[i] < min_depth_ || depth[i] > max_depth_ ? 0 : depth[i];
+              if (points)
+                projectPoint (d, ray, scale, points[i]);
+              if (colored_points)
+              {
+                projectPoint (d, ray, scale, colored_points[i]);
+                colored_points[i].rgba = color[i];
+              }
+            }
+          }
+
+#ifdef PCL_IO_RAY_TABLE_SSE2
+          template <bool Stream> static inline void
+          store (float* address, __m128 value)
+          {
+            if (Stream)
+              _mm_stream_ps (address, value);
+            else
+              _mm_storeu_ps (address, value);
+          }
+
+          template <bool Stream> static inline void
+          store (boost::uint32_t* address, __m128i value)
+          {
+            if (Stream)
+              _mm_stream_si128 (reinterpret_cast<__m128i*> (address), value);
+            else
+              _mm_storeu_si128 (reinterpret_cast<__m128i*> (address), value);
+          }
+#endif
+
+          template <typename PointT> static inline bool
+          isAligned (const PointT* points)
+          {
+            return ((reinterpret_cast<size_t> (points) & 15) == 0);
+          }
+
+          /* Scalar projection of a single point, gives exactly the same
+           * result as the vectorized code path. */
+          template <typename PointT> static inline void
+          projectPoint (unsigned short depth, const float* ray, float scale, PointT& point)
+          {
+            float z = depth == 0 ? std::numeric_limits<float>::quiet_NaN () : depth * scale;
+            point.data[0] = ray[0] * z;
+            point.data[1] = ray[1] * z;
+            point.data[2] = z;
+            point.data[3] = 1.0f;
+          }
+
+          /// Output size (in bytes) above which non-temporal stores are used
+          static const size_t STREAMING_THRESHOLD = 32 * 1024 * 1024;
+
+          size_t width_;
+          size_t height_;
+          CameraIntrinsics intrinsics_;
+
+          /// Rays as (x, y, 1, 0) 4-vectors in row-major pixel order
+          std::vector<float> rays_;
+
+          /// Range of valid depth values
+          unsigned short min_depth_;
+          unsigned short max_depth_;
+
+      };
+
+    }
+
+  }
+
+}
+
+#endif /* PCL_IO_REAL_SENSE_RAY_TABLE_H */
+
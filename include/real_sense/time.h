@@ -38,80 +38,319 @@
 #ifndef PCL_IO_DEPTH_SENSE_TIME_H
 #define PCL_IO_DEPTH_SENSE_TIME_H
 
-#include <queue>
+#include <vector>
+#include <algorithm>
 
-#include <pcl/pcl_config.h>
-#include <pcl/common/time.h>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/thread/once.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/chrono/system_clocks.hpp>
 
 namespace pcl
 {
 
-#if PCL_VERSION < 100800
-
-  /** \brief A helper class to measure frequency of a certain event.
-    *
-    * To use this class create an instance and call event() function every time
-    * the event in question occurs. The estimated frequency can be retrieved
-    * with getFrequency() function.
-    *
-    * \author Sergey Alexandrov
-    * \ingroup common
-    */
-  class EventFrequency
+  namespace io
   {
 
-    public:
+    namespace real_sense
+    {
 
-      /** \brief Constructor.
+      /** Read a monotonic clock, in nanoseconds since an unspecified point.
         *
-        * \param[i] window_size number of most recent events that are
-        * considered in frequency estimation (default: 30) */
-      EventFrequency (size_t window_size = 30)
-      : window_size_ (window_size)
+        * Unlike the system time, the clock never jumps, so the difference of
+        * two readings is a valid duration. This is a steady clock, which is
+        * backed by QueryPerformanceCounter on Windows and CLOCK_MONOTONIC on
+        * Linux. On current hardware both read the invariant TSC without a
+        * system call. */
+      inline boost::uint64_t
+      getMonotonicTimeNs ()
       {
-        stop_watch_.reset ();
+        using namespace boost::chrono;
+        return (duration_cast<nanoseconds> (steady_clock::now ().time_since_epoch ()).count ());
       }
 
-      /** \brief Notifies the class that the event occured. */
-      void event ()
+      /** Read a monotonic clock, in microseconds since an unspecified point.
+        *
+        * Same clock as getMonotonicTimeNs(). */
+      inline boost::uint64_t
+      getMonotonicTime ()
       {
-        event_time_queue_.push (stop_watch_.getTimeSeconds ());
-        if (event_time_queue_.size () > window_size_)
-          event_time_queue_.pop ();
+        return (getMonotonicTimeNs () / 1000);
       }
 
-      /** \brief Retrieve the estimated frequency. */
-      double
-      getFrequency () const
+      /** A timed scope, see ScopeTimeLog. */
+      struct ScopeTimeRecord
       {
-        if (event_time_queue_.size () < 2)
-          return (0.0);
-        return ((event_time_queue_.size () - 1) /
-                (event_time_queue_.back () - event_time_queue_.front ()));
-      }
+        const char* title;
+        /// Monotonic time of entering the scope in nanoseconds
+        boost::uint64_t start;
+        /// Time spent in the scope in nanoseconds
+        boost::uint64_t duration;
+      };
+
+      /** Number of records kept by a ScopeTimeLog. */
+      static const size_t SCOPE_TIME_LOG_CAPACITY = 4096;
 
-      /** \brief Reset frequency computation. */
-      void reset ()
+      /** Per-thread ring buffer of timed scopes.
+        *
+        * Every thread records into its own log (see getCurrent()), so
+        * recording is a handful of stores without locks or allocations. The
+        * log keeps the last SCOPE_TIME_LOG_CAPACITY records. Logs of all
+        * threads, including finished ones, can be read from any thread at any
+        * time (see getAll()). A reader never blocks the owner: each slot
+        * carries a sequence number, and records that the owner overwrites
+        * while they are being copied are skipped.
+        *
+        * When a thread exits, its log is handed over to the next thread that
+        * records a scope. Records of the finished thread can be read until
+        * then, the new owner starts with an empty log. The number of logs is
+        * thus bounded by the largest number of threads that recorded scopes
+        * at the same time, no matter how many threads come and go. */
+      class ScopeTimeLog : boost::noncopyable
       {
-        stop_watch_.reset ();
-        event_time_queue_ = std::queue<double> ();
-      }
 
-    private:
+        public:
 
-      pcl::StopWatch stop_watch_;
-      std::queue<double> event_time_queue_;
-      const size_t window_size_;
+          typedef boost::shared_ptr<ScopeTimeLog> Ptr;
 
-  };
+          ScopeTimeLog (size_t thread_index)
+          : slots_ (new Slot[SCOPE_TIME_LOG_CAPACITY])
+          , num_recorded_ (0)
+          , first_record_ (0)
+          , thread_index_ (thread_index)
+          , thread_name_ ("")
+          {
+            for (size_t i = 0; i < SCOPE_TIME_LOG_CAPACITY; ++i)
+              slots_[i].sequence.store (0, boost::memory_order_relaxed);
+          }
+
+          /** Add a record. Should only be called by the thread that owns the
+            * log. */
+          void
+          record (const char* title, boost::uint64_t start, boost::uint64_t duration)
+          {
+            const size_t n = num_recorded_.load (boost::memory_order_relaxed);
+            Slot& slot = slots_[n % SCOPE_TIME_LOG_CAPACITY];
+            // Odd sequence marks the slot as being written
+            slot.sequence.store (2 * n + 1, boost::memory_order_relaxed);
+            boost::atomic_thread_fence (boost::memory_order_release);
+            slot.title.store (title, boost::memory_order_relaxed);
+            slot.start.store (start, boost::memory_order_relaxed);
+            slot.duration.store (duration, boost::memory_order_relaxed);
+            slot.sequence.store (2 * n + 2, boost::memory_order_release);
+            num_recorded_.store (n + 1, boost::memory_order_release);
+          }
+
+          /** Append the records in the log to \a records, oldest first.
+            *
+            * Can be called from any thread. */
+          void
+          getRecords (std::vector<ScopeTimeRecord>& records) const
+          {
+            const size_t end = num_recorded_.load (boost::memory_order_acquire);
+            // Skip records of the previous owner. The log may be handed over
+            // after end was read, then there is nothing to return.
+            const size_t first = std::min (end, first_record_.load (boost::memory_order_acquire));
+            const size_t begin = std::max (first, end > SCOPE_TIME_LOG_CAPACITY ? end - SCOPE_TIME_LOG_CAPACITY : 0);
+            records.reserve (records.size () + end - begin);
+            for (size_t n = begin; n < end; ++n)
+            {
+              const Slot& slot = slots_[n % SCOPE_TIME_LOG_CAPACITY];
+              const boost::uint64_t sequence = slot.sequence.load (boost::memory_order_acquire);
+              if (sequence != 2 * n + 2)
+                continue;
+              ScopeTimeRecord record;
+              record.title = slot.title.load (boost::memory_order_relaxed);
+              record.start = slot.start.load (boost::memory_order_relaxed);
+              record.duration = slot.duration.load (boost::memory_order_relaxed);
+              boost::atomic_thread_fence (boost::memory_order_acquire);
+              if (slot.sequence.load (boost::memory_order_relaxed) == sequence)
+                records.push_back (record);
+            }
+          }
+
+          /** Get the number of records added since creation, including the
+            * ones that were overwritten. */
+          inline size_t
+          getNumRecorded () const
+          {
+            return (num_recorded_.load (boost::memory_order_relaxed));
+          }
+
+          /** Get the index of the owner thread, in the order in which threads
+            * created their logs. */
+          inline size_t
+          getThreadIndex () const
+          {
+            return (thread_index_);
+          }
+
+          /** Give the owner thread a name (e.g. for traces).
+            *
+            * \param[in] name thread name, which is not copied, so it should be
+            * a string literal */
+          inline void
+          setThreadName (const char* name)
+          {
+            thread_name_.store (name, boost::memory_order_relaxed);
+          }
+
+          inline const char*
+          getThreadName () const
+          {
+            return (thread_name_.load (boost::memory_order_relaxed));
+          }
+
+          /** Get the log of the calling thread. On first use, takes over the
+            * log of a finished thread or creates a new one. */
+          static ScopeTimeLog&
+          getCurrent ()
+          {
+            Registry& registry = getRegistry ();
+            ScopeTimeLog* log = registry.current.get ();
+            if (!log)
+            {
+              boost::mutex::scoped_lock lock (registry.mutex);
+              if (!registry.free.empty ())
+              {
+                log = registry.free.back ();
+                registry.free.pop_back ();
+                log->first_record_.store (log->num_recorded_.load (boost::memory_order_relaxed),
+                                          boost::memory_order_release);
+              }
+              else
+              {
+                registry.logs.push_back (Ptr (new ScopeTimeLog (registry.logs.size ())));
+                log = registry.logs.back ().get ();
+              }
+              const char* name = registry.current_name.get ();
+              log->setThreadName (name ? name : "");
+              registry.current.reset (log);
+            }
+            return (*log);
+          }
+
+          /** Give the calling thread a name (e.g. for traces).
+            *
+            * Unlike getCurrent ().setThreadName (), this does not create a
+            * log for threads that never record anything. The name is copied
+            * into the log once the thread records its first scope.
+            *
+            * \param[in] name thread name, which is not copied, so it should be
+            * a string literal */
+          static void
+          setCurrentThreadName (const char* name)
+          {
+            Registry& registry = getRegistry ();
+            registry.current_name.reset (const_cast<char*> (name));
+            if (ScopeTimeLog* log = registry.current.get ())
+              log->setThreadName (name);
+          }
 
-#endif
+          /** Get the logs of all threads that have recorded anything,
+            * including the logs of finished threads that were not taken over
+            * yet. */
+          static std::vector<Ptr>
+          getAll ()
+          {
+            Registry& registry = getRegistry ();
+            boost::mutex::scoped_lock lock (registry.mutex);
+            return (registry.logs);
+          }
 
+        private:
+
+          struct Slot
+          {
+            boost::atomic<boost::uint64_t> sequence;
+            boost::atomic<const char*> title;
+            boost::atomic<boost::uint64_t> start;
+            boost::atomic<boost::uint64_t> duration;
+          };
+
+          /* Called on thread exit. Logs are owned by the registry, so that
+           * they can be read after their threads finish, and are given to
+           * the next thread that needs one. */
+          static void
+          release (ScopeTimeLog* log)
+          {
+            Registry& registry = getRegistry ();
+            boost::mutex::scoped_lock lock (registry.mutex);
+            registry.free.push_back (log);
+          }
+
+          /* Thread names are string literals, there is nothing to free. */
+          static void
+          releaseName (char*)
+          {
+          }
+
+          struct Registry
+          {
+            Registry () : current (&ScopeTimeLog::release), current_name (&ScopeTimeLog::releaseName) { }
+
+            boost::mutex mutex;
+            std::vector<Ptr> logs;
+            /// Logs of finished threads
+            std::vector<ScopeTimeLog*> free;
+            boost::thread_specific_ptr<ScopeTimeLog> current;
+            /// Name of the calling thread, kept separately so that naming a
+            /// thread does not create a log for it (never written through,
+            /// boost::thread_specific_ptr does not accept const types)
+            boost::thread_specific_ptr<char> current_name;
+          };
+
+          /* Pointer to the registry, statically initialized. The registry
+           * is never destroyed, as threads may exit after static
+           * destructors have run. */
+          static Registry*&
+          getRegistryPointer ()
+          {
+            static Registry* registry = 0;
+            return (registry);
+          }
+
+          static void
+          createRegistry ()
+          {
+            getRegistryPointer () = new Registry;
+          }
+
+          /* Threads reach the registry concurrently on first use, and
+           * initialization of function-local statics is not thread-safe on
+           * older compilers (MSVC before 2015). */
+          static Registry&
+          getRegistry ()
+          {
+            static boost::once_flag once = BOOST_ONCE_INIT;
+            boost::call_once (once, &ScopeTimeLog::createRegistry);
+            return (*getRegistryPointer ());
+          }
+
+          boost::scoped_array<Slot> slots_;
+          boost::atomic<size_t> num_recorded_;
+          /// Index of the first record of the current owner thread
+          boost::atomic<size_t> first_record_;
+          const size_t thread_index_;
+          boost::atomic<const char*> thread_name_;
+
+      };
+
+    }
+
+  }
+
+  /** Measures time with the monotonic clock of getMonotonicTimeNs(). */
   class MyStopWatch
   {
     public:
       /** \brief Constructor. */
-      MyStopWatch () : start_time_ (boost::posix_time::microsec_clock::local_time ())
+      MyStopWatch () : start_time_ (io::real_sense::getMonotonicTimeNs ())
       {
       }
 
@@ -122,58 +361,61 @@ namespace pcl
       inline double
       getTime ()
       {
-        boost::posix_time::ptime end_time = boost::posix_time::microsec_clock::local_time ();
-        return (static_cast<double> (((end_time - start_time_).total_milliseconds ())));
+        return (getTimeNanoSeconds () * 1.0e-6);
       }
 
       /** \brief Retrieve the time in seconds spent since the last call to \a reset(). */
       inline double
       getTimeSeconds ()
       {
-        return (getTime () * 0.001f);
+        return (getTimeNanoSeconds () * 1.0e-9);
       }
 
       inline double
       getTimeMicroSeconds ()
       {
-        boost::posix_time::ptime end_time = boost::posix_time::microsec_clock::local_time ();
-        return (static_cast<double> (((end_time - start_time_).total_microseconds ())));
+        return (getTimeNanoSeconds () * 1.0e-3);
+      }
+
+      inline boost::uint64_t
+      getTimeNanoSeconds ()
+      {
+        return (io::real_sense::getMonotonicTimeNs () - start_time_);
       }
 
       /** \brief Reset the stopwatch to 0. */
       inline void
       reset ()
       {
-        start_time_ = boost::posix_time::microsec_clock::local_time ();
+        start_time_ = io::real_sense::getMonotonicTimeNs ();
       }
 
     protected:
-      boost::posix_time::ptime start_time_;
+      /// Monotonic time in nanoseconds
+      boost::uint64_t start_time_;
   };
 
+  /** Records the time spent in a scope into the ScopeTimeLog of the calling
+    * thread on destruction.
+    *
+    * Cheap enough to be left in hot paths. */
   class MyScopeTime : public MyStopWatch
   {
     public:
-      inline MyScopeTime (const char* title) : 
-        title_ (std::string (title))
-      {
-        start_time_ = boost::posix_time::microsec_clock::local_time ();
-      }
-
-      inline MyScopeTime () :
-        title_ (std::string (""))
+      /** \param[in] title name of the scope, which is not copied, so it
+        * should be a string literal */
+      inline MyScopeTime (const char* title = "") :
+        title_ (title)
       {
-        start_time_ = boost::posix_time::microsec_clock::local_time ();
       }
 
       inline ~MyScopeTime ()
       {
-        double val = this->getTimeMicroSeconds ();
-        std::cerr << title_ << " took " << val << " microseconds.\n";
+        io::real_sense::ScopeTimeLog::getCurrent ().record (title_, start_time_, getTimeNanoSeconds ());
       }
 
     private:
-      std::string title_;
+      const char* title_;
   };
 
 }
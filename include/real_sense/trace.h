@@ -0,0 +1,248 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef PCL_IO_REAL_SENSE_TRACE_H
+#define PCL_IO_REAL_SENSE_TRACE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <algorithm>
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+
+#include "real_sense/time.h"
+
+/* Tracing records timed scopes of all threads into their ScopeTimeLog (see
+ * real_sense/time.h) and exports them as a Chrome trace, which can be opened
+ * in chrome://tracing or Perfetto to see a timeline across threads.
+ *
+ * Scopes are marked with PCL_REAL_SENSE_TRACE_SCOPE. While tracing is
+ * disabled (default), a marked scope costs a single relaxed load and a
+ * branch. Defining PCL_REAL_SENSE_NO_TRACING removes the markers altogether.
+ * Scopes timed with MyScopeTime are always recorded and show up in traces
+ * as well. */
+
+#ifdef PCL_REAL_SENSE_NO_TRACING
+  #define PCL_REAL_SENSE_TRACE_SCOPE(name)
+#else
+  #define PCL_REAL_SENSE_TRACE_CONCAT_IMPL(a, b) a ## b
+  #define PCL_REAL_SENSE_TRACE_CONCAT(a, b) PCL_REAL_SENSE_TRACE_CONCAT_IMPL (a, b)
+  #define PCL_REAL_SENSE_TRACE_SCOPE(name) \
+    pcl::io::real_sense::TraceScope PCL_REAL_SENSE_TRACE_CONCAT (trace_scope_, __LINE__) (name)
+#endif
+
+namespace pcl
+{
+
+  namespace io
+  {
+
+    namespace real_sense
+    {
+
+      namespace detail
+      {
+
+        inline boost::atomic<bool>&
+        getTracingFlag ()
+        {
+          static boost::atomic<bool> enabled (false);
+          return (enabled);
+        }
+
+        /* Write a string as a JSON string literal. */
+        inline void
+        writeJsonString (std::ostream& os, const char* str)
+        {
+          os << '"';
+          for (const char* c = str; *c; ++c)
+          {
+            if (*c == '"' || *c == '\\')
+              os << '\\' << *c;
+            else if (static_cast<unsigned char> (*c) < 0x20)
+              os << ' ';
+            else
+              os << *c;
+          }
+          os << '"';
+        }
+
+        /* Write nanoseconds as (fractional) microseconds, the time unit of
+         * Chrome traces. */
+        inline void
+        writeMicroseconds (std::ostream& os, boost::uint64_t ns)
+        {
+          os << ns / 1000 << '.' << std::setw (3) << std::setfill ('0') << ns % 1000 << std::setfill (' ');
+        }
+
+      }
+
+      inline void
+      setTracingEnabled (bool enabled)
+      {
+        detail::getTracingFlag ().store (enabled, boost::memory_order_relaxed);
+      }
+
+      inline bool
+      isTracingEnabled ()
+      {
+        return (detail::getTracingFlag ().load (boost::memory_order_relaxed));
+      }
+
+      /** Name the calling thread in traces.
+        *
+        * Cheap enough to call on every thread start: the name is only kept
+        * in thread-local storage until the thread records its first scope.
+        *
+        * \param[in] name thread name, which is not copied, so it should be a
+        * string literal */
+      inline void
+      setTraceThreadName (const char* name)
+      {
+        ScopeTimeLog::setCurrentThreadName (name);
+      }
+
+      /** Records the time spent in a scope into the ScopeTimeLog of the
+        * calling thread if tracing is enabled on entering the scope. Use
+        * through PCL_REAL_SENSE_TRACE_SCOPE. */
+      class TraceScope : boost::noncopyable
+      {
+
+        public:
+
+          /** \param[in] name name of the scope, which is not copied, so it
+            * should be a string literal */
+          explicit TraceScope (const char* name)
+          : name_ (name)
+          , start_ (isTracingEnabled () ? getMonotonicTimeNs () : 0)
+          {
+          }
+
+          ~TraceScope ()
+          {
+            if (start_)
+              ScopeTimeLog::getCurrent ().record (name_, start_, getMonotonicTimeNs () - start_);
+          }
+
+        private:
+
+          const char* name_;
+          boost::uint64_t start_;
+
+      };
+
+      /** Write the scopes recorded by all threads as Chrome trace_event JSON.
+        *
+        * Every scope becomes a complete ("X") event, which stands for a pair
+        * of begin and end events. Threads are identified by the index of
+        * their log and named with setTraceThreadName(). Time stamps are
+        * relative to the earliest recorded scope. Can be called at any time
+        * from any thread; logs only keep the most recent scopes of each
+        * thread. */
+      inline void
+      writeChromeTrace (std::ostream& os)
+      {
+        std::vector<ScopeTimeLog::Ptr> logs = ScopeTimeLog::getAll ();
+        std::vector<std::vector<ScopeTimeRecord> > records (logs.size ());
+        boost::uint64_t origin = 0;
+        bool has_origin = false;
+        for (size_t i = 0; i < logs.size (); ++i)
+        {
+          logs[i]->getRecords (records[i]);
+          for (size_t j = 0; j < records[i].size (); ++j)
+          {
+            origin = has_origin ? std::min (origin, records[i][j].start) : records[i][j].start;
+            has_origin = true;
+          }
+        }
+
+        os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        const char* separator = "\n";
+        for (size_t i = 0; i < logs.size (); ++i)
+        {
+          const size_t tid = logs[i]->getThreadIndex ();
+          const char* thread_name = logs[i]->getThreadName ();
+          if (*thread_name)
+          {
+            os << separator << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"name\":";
+            detail::writeJsonString (os, thread_name);
+            os << "}}";
+            separator = ",\n";
+          }
+          for (size_t j = 0; j < records[i].size (); ++j)
+          {
+            const ScopeTimeRecord& record = records[i][j];
+            os << separator << "{\"ph\":\"X\",\"name\":";
+            detail::writeJsonString (os, record.title);
+            os << ",\"pid\":1,\"tid\":" << tid << ",\"ts\":";
+            detail::writeMicroseconds (os, record.start - origin);
+            os << ",\"dur\":";
+            detail::writeMicroseconds (os, record.duration);
+            os << "}";
+            separator = ",\n";
+          }
+        }
+        os << "\n]}\n";
+      }
+
+      /** Write a Chrome trace (see above) to a file.
+        *
+        * \return false if the file could not be written */
+      inline bool
+      writeChromeTrace (const std::string& filename)
+      {
+        std::ofstream file (filename.c_str ());
+        if (!file)
+          return (false);
+        writeChromeTrace (file);
+        file.close ();
+        return (!file.fail ());
+      }
+
+    }
+
+  }
+
+}
+
+#endif /* PCL_IO_REAL_SENSE_TRACE_H */
+
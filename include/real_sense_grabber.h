@@ -40,6 +40,8 @@
 
 #include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/atomic.hpp>
 
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
@@ -48,6 +50,12 @@
 #include <pxcimage.h>
 
 #include "real_sense/time.h"
+#include "real_sense/image.h"
+#include "real_sense/decimation.h"
+#include "bounded_queue.h"
+#include "async_slot.h"
+#include "latency_recorder.h"
+#include "interval_recorder.h"
 
 namespace pcl
 {
@@ -56,10 +64,13 @@ namespace pcl
   {
 
     template <typename T> class Buffer;
+    template <typename T> class ObjectPool;
+    class ThreadPool;
 
     namespace real_sense
     {
       class RealSenseDevice;
+      class RayTable;
     }
 
   }
@@ -77,9 +88,69 @@ namespace pcl
         void (sig_cb_real_sense_point_cloud_rgba)
           (const pcl::PointCloud<pcl::PointXYZRGBA>::ConstPtr&);
 
-      enum Mode
+      typedef pcl::io::real_sense::DepthImage DepthImage;
+      typedef pcl::io::real_sense::ColorImage ColorImage;
+
+      /* Image signals deliver raw images without projecting them into 3D.
+       * Images reference the memory of the SDK images, subscribers should
+       * not hold on to them for long, otherwise the SDK may run out of
+       * buffers. If only image signals are connected, no point clouds are
+       * computed at all. Depth images are temporally filtered (if enabled),
+       * color images are not mapped to depth. */
+
+      typedef
+        void (sig_cb_real_sense_depth_image)
+          (const DepthImage::ConstPtr&);
+
+      typedef
+        void (sig_cb_real_sense_color_image)
+          (const ColorImage::ConstPtr&);
+
+      typedef
+        void (sig_cb_real_sense_images)
+          (const DepthImage::ConstPtr&, const ColorImage::ConstPtr&);
+
+      typedef pcl::io::AsyncSlot<pcl::PointCloud<pcl::PointXYZ>::ConstPtr> AsyncPointCloudSlot;
+      typedef pcl::io::AsyncSlot<pcl::PointCloud<pcl::PointXYZRGBA>::ConstPtr> AsyncPointCloudRGBASlot;
+
+      /** A capture mode, i.e. frame rate and resolutions of depth and color
+        * streams.
+        *
+        * When requesting a mode, zero values mean "any". For example,
+        * Mode (60, 320, 240) requests QVGA depth at 60 Hz with whatever color
+        * resolution the device supports at this rate. Color resolution is
+        * ignored if there are no subscribers for colored clouds, which makes
+        * higher-rate depth-only profiles available. */
+      struct Mode
       {
-        RealSense_VGA_30Hz = 0,
+        /** Default mode: VGA depth and color at 30 Hz. */
+        Mode ()
+        : fps (30), depth_width (640), depth_height (480), color_width (640), color_height (480)
+        {
+        }
+
+        Mode (unsigned int fps,
+              unsigned int depth_width,
+              unsigned int depth_height,
+              unsigned int color_width = 0,
+              unsigned int color_height = 0)
+        : fps (fps), depth_width (depth_width), depth_height (depth_height), color_width (color_width), color_height (color_height)
+        {
+        }
+
+        bool
+        operator== (const Mode& other) const
+        {
+          return (fps == other.fps &&
+                  depth_width == other.depth_width && depth_height == other.depth_height &&
+                  color_width == other.color_width && color_height == other.color_height);
+        }
+
+        unsigned int fps;
+        unsigned int depth_width;
+        unsigned int depth_height;
+        unsigned int color_width;
+        unsigned int color_height;
       };
 
       enum TemporalFilteringType
@@ -87,6 +158,33 @@ namespace pcl
         RealSense_None = 0,
         RealSense_Median = 1,
         RealSense_Average = 2,
+        RealSense_Exponential = 3,
+        RealSense_Adaptive = 4,
+      };
+
+      /** Durations (in microseconds) of the stages that frames go through,
+        * see getPipelineStats().
+        *
+        * Stages that are skipped for a frame (e.g. filtering with temporal
+        * filtering disabled) are not recorded for it. */
+      struct PipelineStats
+      {
+        /// Time between capture and the start of processing, spent in the
+        /// frame queue
+        pcl::io::LatencyStatistics queue;
+        /// Cropping and decimation of depth images
+        pcl::io::LatencyStatistics decimation;
+        /// Pushing depth images to and pulling them from the depth buffer,
+        /// without waiting for the preceding frames
+        pcl::io::LatencyStatistics filtering;
+        /// Mapping color images to depth images
+        pcl::io::LatencyStatistics mapping;
+        /// Projection into 3D, filling XYZ and XYZRGBA clouds
+        pcl::io::LatencyStatistics projection;
+        /// Invocation of callbacks
+        pcl::io::LatencyStatistics dispatch;
+        /// All of the above except for queueing
+        pcl::io::LatencyStatistics total;
       };
 
       /** Create a grabber for a RealSense device.
@@ -100,8 +198,10 @@ namespace pcl
         *
         * \param[in] device_id device identifier, which can be a serial number,
         * an index (with '#' prefix), or an empty string (to select the first
-        * available device) */
-      RealSenseGrabber (const std::string& device_id = "");
+        * available device)
+        * \param[in] mode requested capture mode (see setMode())
+        * \param[in] strict whether the mode should be matched exactly */
+      RealSenseGrabber (const std::string& device_id = "", const Mode& mode = Mode (), bool strict = false);
 
       virtual
       ~RealSenseGrabber () throw ();
@@ -121,34 +221,267 @@ namespace pcl
         return (std::string ("RealSenseGrabber"));
       }
 
+      /** Get the mean frame rate over the most recent frames.
+        *
+        * Does not block, so it can be polled at any rate without slowing
+        * down capture. */
       virtual float
       getFramesPerSecond () const;
 
+      /** Get statistics of intervals (in microseconds) between the most
+        * recent frames read from the device.
+        *
+        * Intervals are measured between sensor time stamps. Missed frames are
+        * estimated from the frame rate of the selected mode. Does not block. */
+      pcl::io::IntervalStatistics
+      getFrameIntervalStatistics () const;
+
+      /** Get the estimated number of frames that the device did not deliver
+        * since the last start(), based on the frame rate of the selected
+        * mode.
+        *
+        * Unlike getNumDroppedFrames(), these frames never reached the
+        * grabber. */
+      size_t
+      getNumMissedFrames () const;
+
       void
       setConfidenceThreshold (unsigned int threshold);
 
+      /** Enable temporal filtering of depth images.
+        *
+        * For RealSense_Exponential filtering the smoothing factor is derived
+        * from the window size as 2 / (window_size + 1), which gives the same
+        * center of mass as averaging over \a window_size frames.
+        *
+        * RealSense_Adaptive filtering averages each pixel over up to
+        * \a window_size frames, but restarts its history when the depth
+        * changes by more than the motion threshold (see
+        * setMotionThreshold()).
+        *
+        * RealSense_Median filtering supports windows of up to 65535 frames:
+        * windows of 3, 5 and 7 frames use sorting networks, windows up to 255
+        * frames keep the window of each pixel sorted, and larger windows use
+        * per-pixel depth histograms (see pcl::io::HistogramMedianBuffer),
+        * which make the cost independent of the window size at the price of
+        * about 1.5 KB of memory per pixel. */
       void
       enableTemporalFiltering (TemporalFilteringType type, size_t window_size);
 
       void
       disableTemporalFiltering ();
 
+      /** Set the depth change (in millimeters) above which adaptive temporal
+        * filtering considers a pixel to be moving and restarts its history
+        * (default: 20). */
+      void
+      setMotionThreshold (float threshold);
+
+      /** Set the number of threads used for temporal filtering.
+        *
+        * Temporal filters process depth images in tiles that are distributed
+        * over a pool of worker threads. By default (and when \a num_threads
+        * is 0 or 1) filtering is done on the grabber thread. */
+      void
+      setNumFilteringThreads (size_t num_threads);
+
+      /** Decimate depth images by an integer factor.
+        *
+        * Blocks of \a factor x \a factor depth pixels are reduced to one
+        * before temporal filtering and projection, so clouds (and depth
+        * images) come out at a fraction of the depth stream resolution, e.g.
+        * 320x240 or 160x120 for VGA depth with factor 2 or 4. Temporal
+        * filtering and projection become proportionally cheaper. Colors of
+        * XYZRGBA clouds are sampled from the center of each block.
+        *
+        * Factor 1 (default) disables decimation. Binning (DECIMATION_MEDIAN
+        * and DECIMATION_MEAN) supports factors up to 4, otherwise
+        * pcl::io::IOException is thrown.
+        *
+        * If the grabber is running, it is restarted. */
+      void
+      setDecimation (unsigned int factor, pcl::io::real_sense::DecimationMethod method = pcl::io::real_sense::DECIMATION_STRIDE);
+
+      /** Restrict output to a rectangular region of the depth image.
+        *
+        * The region is given in pixels of the depth stream (before
+        * decimation) and is clipped to the image on start(). Depth images are
+        * cropped before temporal filtering, so filtering and projection only
+        * happen inside the region, and clouds (and depth images) have the
+        * size of the region (divided by the decimation factor). Zero width
+        * or height (default) extends the region to the image border.
+        *
+        * If the grabber is running, it is restarted. */
+      void
+      setRegionOfInterest (unsigned int x, unsigned int y, unsigned int width, unsigned int height);
+
+      /** Set the range of depth (in meters) that is considered valid.
+        *
+        * Points with depth outside of the range are invalidated (set to NaN)
+        * during projection. Zero \a max_depth (default) means no upper limit.
+        * Together with setRegionOfInterest() this restricts clouds to a
+        * frustum-shaped volume. Depth images are not affected. */
+      void
+      setDepthRange (float min_depth, float max_depth);
+
+      /** Set the maximum number of point clouds of each type that the
+        * grabber keeps for reuse (default: 4).
+        *
+        * Clouds passed to subscribers are returned to a pool when the last
+        * reference to them is dropped and reused for subsequent frames. If
+        * subscribers hold on to more clouds than the pool size, extra clouds
+        * are allocated for every frame. Zero disables pooling. */
+      void
+      setCloudPoolSize (size_t size);
+
+      /** Set the capture mode.
+        *
+        * The mode is selected among those supported by the device when the
+        * grabber is started. If \a strict is set, every non-zero field of
+        * the requested mode has to match exactly, otherwise start() throws.
+        * If not, the closest supported mode is used, preferring frame rate
+        * over depth resolution over color resolution.
+        *
+        * If the grabber is running, it is restarted. */
+      void
+      setMode (const Mode& mode, bool strict = false);
+
+      /** Get the capture mode.
+        *
+        * This is the mode actually used by the device if the grabber has been
+        * started, and the requested mode otherwise. */
+      const Mode&
+      getMode () const;
+
+      /** Get the capture modes supported by the device.
+        *
+        * \param[in] only_depth list depth-only modes (color resolution is
+        * zero), otherwise only modes where depth and color streams have the
+        * same frame rate are listed */
+      std::vector<Mode>
+      getAvailableModes (bool only_depth = false) const;
+
+      /** Configure the queue of frames between acquisition and processing.
+        *
+        * Frames are read from the device on a dedicated acquisition thread
+        * and passed to processing threads (filtering, projection and signal
+        * dispatch) through a bounded queue, so that slow processing does
+        * not delay reading from the device. The policy decides what happens
+        * when the queue is full (default: capacity 2, DROP_OLDEST).
+        *
+        * If the grabber is running, it is restarted. */
+      void
+      setFrameQueue (size_t capacity, pcl::io::OverflowPolicy policy);
+
+      /** Set the number of threads that process frames (default: 1).
+        *
+        * With several threads, frames are filtered in the order they were
+        * captured, but clouds may be delivered to subscribers out of order.
+        *
+        * If the grabber is running, it is restarted. */
+      void
+      setNumProcessingThreads (size_t num_threads);
+
+      /** Get the number of frames read from the device since the last
+        * start(). */
+      size_t
+      getNumCapturedFrames () const;
+
+      /** Get the number of frames dropped since the last start() because
+        * processing did not keep up with the device. */
+      size_t
+      getNumDroppedFrames () const;
+
+      /** Get statistics of the end-to-end latency over the most recent
+        * frames since the last start().
+        *
+        * Latency is the time (in microseconds) from capture of a frame by the
+        * sensor, as stamped by the device, until the callbacks for it are
+        * invoked. It includes queueing in the SDK and in the grabber, but not
+        * the time spent in callbacks. */
+      pcl::io::LatencyStatistics
+      getLatencyStatistics () const;
+
+      /** Get statistics of the durations of processing stages over the most
+        * recent frames since the last start().
+        *
+        * Stages are timed for every frame with a monotonic clock, so these
+        * can be polled on a live system to see which stage takes up the
+        * frame budget. */
+      PipelineStats
+      getPipelineStats () const;
+
+      /** Periodically print pipeline statistics (see getPipelineStats()).
+        *
+        * \param[in] period time between log lines in seconds, zero (default)
+        * disables logging */
+      void
+      setPipelineStatsLogging (float period);
+
+      /** Register a callback that is invoked on its own worker thread.
+        *
+        * Callbacks registered with registerCallback() are invoked one after
+        * another on the processing thread, so a slow subscriber delays the
+        * following frames. A callback registered with this function gets a
+        * dedicated thread and a mailbox that only keeps the latest cloud: if
+        * the callback is still busy when new clouds arrive, stale ones are
+        * skipped.
+        *
+        * The callback stays connected as long as the returned slot exists.
+        * The slot also reports how many clouds were delivered and skipped. */
+      AsyncPointCloudSlot::Ptr
+      registerAsyncCallback (const boost::function<sig_cb_real_sense_point_cloud>& callback);
+
+      AsyncPointCloudRGBASlot::Ptr
+      registerAsyncCallback (const boost::function<sig_cb_real_sense_point_cloud_rgba>& callback);
+
       const std::string&
       getDeviceSerialNumber () const;
 
     private:
 
+      /// Frame read from the device, holds its images until destroyed
+      struct Frame;
+      typedef boost::shared_ptr<Frame> FramePtr;
+
+      /** Acquisition thread function, reads frames from the device and puts
+        * them into the frame queue. */
       void run ();
 
+      /** Processing thread function, takes frames from the frame queue and
+        * turns them into images and point clouds. */
+      void process ();
+
+      /** Select the supported mode that best matches the requested one. */
+      Mode
+      selectMode (bool only_depth) const;
+
+      /** Create the depth buffer for the selected temporal filtering type
+        * and mode. */
+      void
+      createDepthBuffer ();
+
+      /** Print pipeline statistics if logging is enabled and the log period
+        * has passed since the last time. */
+      void
+      logPipelineStats ();
+
       // Signals to indicate whether new clouds are available
       boost::signals2::signal<sig_cb_real_sense_point_cloud>* point_cloud_signal_;
       boost::signals2::signal<sig_cb_real_sense_point_cloud_rgba>* point_cloud_rgba_signal_;
 
+      // Signals to indicate whether new images are available
+      boost::signals2::signal<sig_cb_real_sense_depth_image>* depth_image_signal_;
+      boost::signals2::signal<sig_cb_real_sense_color_image>* color_image_signal_;
+      boost::signals2::signal<sig_cb_real_sense_images>* images_signal_;
+
       boost::shared_ptr<pcl::io::real_sense::RealSenseDevice> device_;
 
       bool is_running_;
       unsigned int confidence_threshold_;
       TemporalFilteringType temporal_filtering_type_;
+      size_t temporal_filtering_window_size_;
+      float motion_threshold_;
 
       /// Indicates whether there are subscribers for PointXYZ signal, computed
       /// and stored on start()
@@ -158,21 +491,114 @@ namespace pcl
       /// computed and stored on start()
       bool need_xyzrgba_;
 
-      EventFrequency frequency_;
-      mutable boost::mutex fps_mutex_;
-
-      boost::thread thread_;
-
-      static const int FRAMERATE = 30;
-      static const int WIDTH = 640;
-      static const int HEIGHT = 480;
-      static const int SIZE = WIDTH * HEIGHT;
-      static const int COLOR_WIDTH = 640;
-      static const int COLOR_HEIGHT = 480;
-      static const int COLOR_SIZE = COLOR_WIDTH * COLOR_HEIGHT;
+      /// Indicates whether there are subscribers for depth (color) images,
+      /// either alone or in pairs, computed and stored on start()
+      bool need_depth_image_;
+      bool need_color_image_;
+
+      /// Indicates whether the color stream should be captured, i.e. there
+      /// are subscribers for XYZRGBA clouds or color images
+      bool need_color_;
+
+      /// Intervals between frames, written by the acquisition thread only
+      pcl::io::IntervalRecorder frame_intervals_;
+
+      boost::thread acquisition_thread_;
+      std::vector<boost::shared_ptr<boost::thread> > processing_threads_;
+      size_t num_processing_threads_;
+
+      /// Queue of frames waiting for processing, created on start()
+      boost::shared_ptr<pcl::io::BoundedQueue<FramePtr> > frame_queue_;
+      size_t frame_queue_capacity_;
+      pcl::io::OverflowPolicy frame_queue_policy_;
+
+      /// Serializes taking frames from the queue and numbering them
+      boost::mutex pop_mutex_;
+      size_t next_frame_sequence_;
+
+      /// Make sure temporal filtering sees frames in the order they were
+      /// taken from the queue
+      boost::mutex filter_mutex_;
+      boost::condition_variable filter_turn_;
+      size_t next_filter_sequence_;
+
+      /// Sensor-to-callback latency of recent frames
+      pcl::io::LatencyRecorder latency_recorder_;
+
+      /// Durations of processing stages of recent frames
+      pcl::io::LatencyRecorder queue_time_;
+      pcl::io::LatencyRecorder decimation_time_;
+      pcl::io::LatencyRecorder filtering_time_;
+      pcl::io::LatencyRecorder mapping_time_;
+      pcl::io::LatencyRecorder projection_time_;
+      pcl::io::LatencyRecorder dispatch_time_;
+      pcl::io::LatencyRecorder total_time_;
+
+      /// Period of pipeline statistics logging in microseconds, zero if
+      /// disabled (may be changed while processing threads read it)
+      boost::atomic<boost::uint64_t> pipeline_stats_log_period_;
+      boost::uint64_t last_pipeline_stats_log_;
+      boost::mutex pipeline_stats_log_mutex_;
+
+      Mode mode_requested_;
+      bool strict_;
+
+      /// Mode used by the device, selected on start()
+      Mode mode_selected_;
+
+      unsigned int decimation_factor_;
+      pcl::io::real_sense::DecimationMethod decimation_method_;
+
+      /// Requested region of interest
+      unsigned int roi_x_;
+      unsigned int roi_y_;
+      unsigned int roi_width_;
+      unsigned int roi_height_;
+
+      /// Region of interest clipped to the depth image, computed on start()
+      unsigned int crop_x_;
+      unsigned int crop_y_;
+      unsigned int crop_width_;
+      unsigned int crop_height_;
+
+      /// Valid depth range in meters
+      float min_depth_;
+      float max_depth_;
+
+      /// Size of depth images after cropping and decimation, computed on
+      /// start()
+      unsigned int output_width_;
+      unsigned int output_height_;
+
+      /// Whether depth images are cropped and/or decimated, computed on
+      /// start()
+      bool transform_depth_;
+
+      /// Pool of cropped and decimated depth images, created on start() if
+      /// needed
+      boost::shared_ptr<pcl::io::ObjectPool<std::vector<boost::uint16_t> > > output_depth_pool_;
 
       /// Depth buffer to perform temporal filtering of the depth images
       boost::shared_ptr<pcl::io::Buffer<unsigned short> > depth_buffer_;
+
+      /// Maximum number of clouds in each of the cloud pools
+      size_t cloud_pool_size_;
+
+      /// Pools of clouds passed to subscribers, created on start()
+      boost::shared_ptr<pcl::io::ObjectPool<pcl::PointCloud<pcl::PointXYZ> > > xyz_cloud_pool_;
+      boost::shared_ptr<pcl::io::ObjectPool<pcl::PointCloud<pcl::PointXYZRGBA> > > xyzrgba_cloud_pool_;
+
+      /// Rays of depth pixels, built from the depth stream calibration on
+      /// start()
+      boost::shared_ptr<pcl::io::real_sense::RayTable> ray_table_;
+
+      /// Rays of cropped and decimated depth pixels, empty if depth images
+      /// are used as is
+      boost::shared_ptr<pcl::io::real_sense::RayTable> output_ray_table_;
+
+      /// Thread pool used by the depth buffer, empty if filtering is done on
+      /// the grabber thread
+      boost::shared_ptr<pcl::io::ThreadPool> filtering_thread_pool_;
 	
   };
 
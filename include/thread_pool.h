@@ -0,0 +1,239 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef PCL_IO_THREAD_POOL_H
+#define PCL_IO_THREAD_POOL_H
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/utility.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace pcl
+{
+
+  namespace io
+  {
+
+    /** A pool of persistent worker threads that process index ranges.
+      *
+      * The range passed to parallelFor() is split into tiles of fixed size,
+      * which are handed out to the workers (and the calling thread) one by
+      * one. Workers sleep on a condition variable between calls, so the
+      * pool costs nothing when idle. */
+    class ThreadPool : boost::noncopyable
+    {
+
+      public:
+
+        typedef boost::shared_ptr<ThreadPool> Ptr;
+
+        /** Create a pool.
+          *
+          * \param[in] num_threads total number of threads that process tiles,
+          * including the thread that calls parallelFor() */
+        ThreadPool (size_t num_threads)
+        : num_threads_ (std::max<size_t> (num_threads, 1))
+        , task_ (0)
+        , next_ (0)
+        , end_ (0)
+        , tile_size_ (1)
+        , remaining_ (0)
+        , stop_ (false)
+        {
+          for (size_t i = 1; i < num_threads_; ++i)
+            threads_.create_thread (boost::bind (&ThreadPool::work, this));
+        }
+
+        ~ThreadPool ()
+        {
+          {
+            boost::mutex::scoped_lock lock (mutex_);
+            stop_ = true;
+          }
+          tile_available_.notify_all ();
+          threads_.join_all ();
+        }
+
+        inline size_t
+        getNumThreads () const
+        {
+          return (num_threads_);
+        }
+
+        /** Call \a f (tile_begin, tile_end) for every tile of the range
+          * [\a begin, \a end) and wait until all of them are processed.
+          *
+          * Tiles are processed concurrently and in no particular order, so
+          * \a f should only touch data that belongs to its tile. Concurrent
+          * calls from different threads are serialized.
+          *
+          * If \a f throws, tiles that have not been started yet are skipped,
+          * and the first exception is rethrown here once all running tiles
+          * are done. Exceptions are transported with boost::exception_ptr,
+          * so types other than standard exceptions arrive as
+          * boost::unknown_exception. */
+        template <typename F> void
+        parallelFor (size_t begin, size_t end, size_t tile_size, F f)
+        {
+          if (begin >= end)
+            return;
+          boost::mutex::scoped_lock call_lock (call_mutex_);
+          TaskImpl<F> task (f);
+          boost::mutex::scoped_lock lock (mutex_);
+          task_ = &task;
+          next_ = begin;
+          end_ = end;
+          tile_size_ = std::max<size_t> (tile_size, 1);
+          remaining_ = (end - begin + tile_size_ - 1) / tile_size_;
+          tile_available_.notify_all ();
+          processTiles (lock);
+          while (remaining_ > 0)
+            tiles_done_.wait (lock);
+          task_ = 0;
+          if (error_)
+          {
+            boost::exception_ptr error = error_;
+            error_ = boost::exception_ptr ();
+            boost::rethrow_exception (error);
+          }
+        }
+
+      private:
+
+        struct Task
+        {
+          virtual ~Task () { }
+          virtual void operator() (size_t begin, size_t end) = 0;
+        };
+
+        template <typename F>
+        struct TaskImpl : Task
+        {
+          TaskImpl (F& f) : f_ (f) { }
+          virtual void operator() (size_t begin, size_t end) { f_ (begin, end); }
+          F& f_;
+        };
+
+        /* Take tiles and process them until there are none left. Should be
+         * called with the mutex locked, returns with the mutex locked. */
+        void
+        processTiles (boost::mutex::scoped_lock& lock)
+        {
+          while (next_ < end_)
+          {
+            size_t begin = next_;
+            size_t end = std::min (begin + tile_size_, end_);
+            next_ = end;
+            Task* task = task_;
+            lock.unlock ();
+            boost::exception_ptr error;
+            try
+            {
+              (*task) (begin, end);
+            }
+            catch (...)
+            {
+              error = boost::current_exception ();
+            }
+            lock.lock ();
+            if (error)
+            {
+              if (!error_)
+                error_ = error;
+              // Skip the tiles that were not handed out yet
+              remaining_ -= (end_ - next_ + tile_size_ - 1) / tile_size_;
+              next_ = end_;
+            }
+            if (--remaining_ == 0)
+              tiles_done_.notify_all ();
+          }
+        }
+
+        void
+        work ()
+        {
+          boost::mutex::scoped_lock lock (mutex_);
+          while (true)
+          {
+            while (!stop_ && next_ >= end_)
+              tile_available_.wait (lock);
+            if (stop_)
+              return;
+            processTiles (lock);
+          }
+        }
+
+        const size_t num_threads_;
+
+        boost::thread_group threads_;
+
+        /// Protects the state of the current task
+        boost::mutex mutex_;
+
+        /// Serializes parallelFor() calls
+        boost::mutex call_mutex_;
+
+        boost::condition_variable tile_available_;
+        boost::condition_variable tiles_done_;
+
+        Task* task_;
+        size_t next_;
+        size_t end_;
+        size_t tile_size_;
+
+        /// Number of tiles of the current task that are not processed yet
+        size_t remaining_;
+
+        /// First exception thrown by the current task
+        boost::exception_ptr error_;
+
+        bool stop_;
+
+    };
+
+  }
+
+}
+
+#endif /* PCL_IO_THREAD_POOL_H */
+
@@ -35,49 +35,237 @@
  *
  */
 
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <pxcimage.h>
 #include <pxccapture.h>
 #include <pxcsensemanager.h>
 #include <pxcprojection.h>
 
-#include <pcl/common/io.h>
-#include <pcl/common/time.h>
-
 #include "real_sense_grabber.h"
 #include "real_sense/real_sense_device_manager.h"
+#include "real_sense/ray_table.h"
+#include "real_sense/decimation.h"
+#include "real_sense/point_conversion.h"
+#include "real_sense/trace.h"
 #include "buffers.h"
+#include "object_pool.h"
 #include "io_exception.h"
 
 using namespace pcl::io::real_sense;
 
-/* Helper function to convert a PXCPoint3DF32 point into a PCL point.
- * Takes care of unit conversion (PXC point coordinates are in millimeters)
- * and invalid points. */
-template <typename T> inline void
-convertPoint (const PXCPoint3DF32& src, T& tgt)
+struct pcl::RealSenseGrabber::Frame
 {
-  static const float nan = std::numeric_limits<float>::quiet_NaN ();
-  if (src.z == 0)
+  /* Take over the images of a sample, so that they are not released
+   * together with it. */
+  Frame (PXCCapture::Sample& sample, uint64_t timestamp)
+  : depth (sample.depth)
+  , color (sample.color)
+  , timestamp (timestamp)
+  , queued (getMonotonicTime ())
+  , sequence (0)
   {
-    tgt.x = tgt.y = tgt.z = nan;
+    sample.depth = 0;
+    sample.color = 0;
   }
-  else
+
+  ~Frame ()
+  {
+    if (depth)
+      depth->Release ();
+    if (color)
+      color->Release ();
+  }
+
+  PXCImage* depth;
+  PXCImage* color;
+  uint64_t timestamp;
+  /// Monotonic time when the frame was created, i.e. put in the queue
+  uint64_t queued;
+  size_t sequence;
+};
+
+/* Access to the data of a PXC image that lasts until destruction. Keeps
+ * the frame (and thus the image) alive. */
+struct ImageAccess
+{
+  ImageAccess (const boost::shared_ptr<void>& frame, PXCImage* image, PXCImage::PixelFormat format)
+  : frame (frame)
+  , image (image)
+  {
+    image->AcquireAccess (PXCImage::ACCESS_READ, format, &data);
+  }
+
+  ~ImageAccess ()
   {
-    tgt.x = src.x / 1000.0;
-    tgt.y = src.y / 1000.0;
-    tgt.z = src.z / 1000.0;
+    image->ReleaseAccess (&data);
   }
+
+  boost::shared_ptr<void> frame;
+  PXCImage* image;
+  PXCImage::ImageData data;
+};
+
+/* Helper function to create an image that references the data of a PXC
+ * image directly. */
+template <typename PixelT> typename pcl::io::real_sense::Image<PixelT>::ConstPtr
+createImage (const boost::shared_ptr<void>& frame, PXCImage* image, PXCImage::PixelFormat format, uint64_t timestamp)
+{
+  boost::shared_ptr<ImageAccess> access (new ImageAccess (frame, image, format));
+  PXCImage::ImageInfo info = image->QueryInfo ();
+  const PixelT* data = reinterpret_cast<const PixelT*> (access->data.planes[0]);
+  return (typename pcl::io::real_sense::Image<PixelT>::ConstPtr
+          (new pcl::io::real_sense::Image<PixelT> (data, info.width, info.height, access->data.pitches[0], timestamp, access)));
+}
+
+/* PXC time stamps count 100 ns intervals since January 1, 1601 (UTC). This
+ * is their value at the Unix epoch. */
+static const pxcI64 PXC_TIME_STAMP_UNIX_EPOCH = 116444736000000000LL;
+
+/* Helper function to convert PXC time stamps to microseconds since the Unix
+ * epoch, the units of point cloud header stamps. */
+uint64_t
+toMicroseconds (pxcI64 time_stamp)
+{
+  return ((time_stamp - PXC_TIME_STAMP_UNIX_EPOCH) / 10);
+}
+
+/* Helper function to get the system time (UTC) in microseconds since the
+ * Unix epoch. The SDK stamps images with the same clock, so the result can
+ * be compared with converted PXC time stamps. */
+uint64_t
+getSystemTime ()
+{
+  static const boost::posix_time::ptime epoch (boost::gregorian::date (1970, 1, 1));
+  return ((boost::posix_time::microsec_clock::universal_time () - epoch).total_microseconds ());
+}
+
+/* Helper function to record the monotonic time elapsed since \a time and
+ * advance \a time to now. */
+inline void
+recordStage (pcl::io::LatencyRecorder& recorder, uint64_t& time)
+{
+  const uint64_t now = getMonotonicTime ();
+  recorder.record (now - time);
+  time = now;
+}
+
+/* Helper function to connect an asynchronous slot to a signal. The signal
+ * only tracks the slot, so it is disconnected automatically once the last
+ * reference to the slot is dropped. */
+template <typename T> typename pcl::io::AsyncSlot<T>::Ptr
+connectAsyncSlot (boost::signals2::signal<void (const T&)>& signal, const boost::function<void (const T&)>& callback)
+{
+  typedef boost::signals2::signal<void (const T&)> Signal;
+  typename pcl::io::AsyncSlot<T>::Ptr slot (new pcl::io::AsyncSlot<T> (callback));
+  signal.connect (typename Signal::slot_type (&pcl::io::AsyncSlot<T>::post, slot.get (), _1).track (slot));
+  return (slot);
 }
 
+/* Helper function to create depth images for the output depth pool. */
+std::vector<boost::uint16_t>*
+createDepthImage (size_t size)
+{
+  return (new std::vector<boost::uint16_t> (size));
+}
 
-pcl::RealSenseGrabber::RealSenseGrabber (const std::string& device_id)
+/* Helper function to (re)build a ray table, unless the existing one already
+ * has the requested size and intrinsics. */
+void
+updateRayTable (boost::shared_ptr<pcl::io::real_sense::RayTable>& table,
+                unsigned int width,
+                unsigned int height,
+                const pcl::io::real_sense::CameraIntrinsics& intrinsics)
+{
+  if (!table ||
+      table->getWidth () != width ||
+      table->getHeight () != height ||
+      memcmp (&table->getIntrinsics (), &intrinsics, sizeof (intrinsics)) != 0)
+    table.reset (new pcl::io::real_sense::RayTable (width, height, intrinsics));
+}
+
+/* Helper function to create organized point clouds for cloud pools. */
+template <typename PointT> pcl::PointCloud<PointT>*
+createCloud (unsigned int width, unsigned int height)
+{
+  pcl::PointCloud<PointT>* cloud = new pcl::PointCloud<PointT> (width, height);
+  cloud->is_dense = false;
+  return (cloud);
+}
+
+/* Maximum deviation (in meters) between points projected with the ray table
+ * and the vertices computed by the SDK for the ray table to be used. */
+static const float MAX_RAY_TABLE_DEVIATION = 0.002f;
+
+/* Helper function to check that points projected with a ray table agree with
+ * the vertices computed by the SDK (in millimeters). Returns the maximum
+ * deviation in meters. */
+static float
+computeRayTableDeviation (const pcl::io::real_sense::RayTable& table,
+                          const unsigned short* depth,
+                          const std::vector<PXCPoint3DF32>& vertices)
+{
+  float max_deviation = 0.0f;
+  for (size_t v = 0, i = 0; v < table.getHeight (); ++v)
+    for (size_t u = 0; u < table.getWidth (); ++u, ++i)
+    {
+      if (depth[i] == 0 || vertices[i].z == 0)
+        continue;
+      const float* ray = table.getRay (u, v);
+      float z = depth[i] * 0.001f;
+      max_deviation = std::max (max_deviation, std::fabs (ray[0] * z - vertices[i].x * 0.001f));
+      max_deviation = std::max (max_deviation, std::fabs (ray[1] * z - vertices[i].y * 0.001f));
+      max_deviation = std::max (max_deviation, std::fabs (z - vertices[i].z * 0.001f));
+    }
+  return (max_deviation);
+}
+
+
+pcl::RealSenseGrabber::RealSenseGrabber (const std::string& device_id, const Mode& mode, bool strict)
 : Grabber ()
 , is_running_ (false)
 , confidence_threshold_ (6)
 , temporal_filtering_type_ (RealSense_None)
-, depth_buffer_ (new pcl::io::SingleBuffer<unsigned short> (SIZE))
+, temporal_filtering_window_size_ (1)
+, motion_threshold_ (20.0f)
+, need_xyz_ (false)
+, need_xyzrgba_ (false)
+, need_depth_image_ (false)
+, need_color_image_ (false)
+, need_color_ (false)
+, num_processing_threads_ (1)
+, frame_queue_capacity_ (2)
+, frame_queue_policy_ (pcl::io::DROP_OLDEST)
+, next_frame_sequence_ (0)
+, next_filter_sequence_ (0)
+, pipeline_stats_log_period_ (0)
+, last_pipeline_stats_log_ (0)
+, mode_requested_ (mode)
+, strict_ (strict)
+, mode_selected_ (mode)
+, decimation_factor_ (1)
+, decimation_method_ (pcl::io::real_sense::DECIMATION_STRIDE)
+, roi_x_ (0)
+, roi_y_ (0)
+, roi_width_ (0)
+, roi_height_ (0)
+, crop_x_ (0)
+, crop_y_ (0)
+, crop_width_ (0)
+, crop_height_ (0)
+, min_depth_ (0.0f)
+, max_depth_ (0.0f)
+, output_width_ (0)
+, output_height_ (0)
+, transform_depth_ (false)
+, cloud_pool_size_ (4)
 {
   if (device_id == "")
     device_ = RealSenseDeviceManager::getInstance ()->captureDevice ();
@@ -88,6 +276,9 @@ pcl::RealSenseGrabber::RealSenseGrabber (const std::string& device_id)
 
   point_cloud_signal_ = createSignal<sig_cb_real_sense_point_cloud> ();
   point_cloud_rgba_signal_ = createSignal<sig_cb_real_sense_point_cloud_rgba> ();
+  depth_image_signal_ = createSignal<sig_cb_real_sense_depth_image> ();
+  color_image_signal_ = createSignal<sig_cb_real_sense_color_image> ();
+  images_signal_ = createSignal<sig_cb_real_sense_images> ();
 }
 
 pcl::RealSenseGrabber::~RealSenseGrabber () throw ()
@@ -96,6 +287,9 @@ pcl::RealSenseGrabber::~RealSenseGrabber () throw ()
 
   disconnect_all_slots<sig_cb_real_sense_point_cloud> ();
   disconnect_all_slots<sig_cb_real_sense_point_cloud_rgba> ();
+  disconnect_all_slots<sig_cb_real_sense_depth_image> ();
+  disconnect_all_slots<sig_cb_real_sense_color_image> ();
+  disconnect_all_slots<sig_cb_real_sense_images> ();
 }
 
 void
@@ -105,25 +299,30 @@ pcl::RealSenseGrabber::start ()
   {
     need_xyz_ = num_slots<sig_cb_real_sense_point_cloud> () > 0;
     need_xyzrgba_ = num_slots<sig_cb_real_sense_point_cloud_rgba> () > 0;
-    if (need_xyz_ || need_xyzrgba_)
+    bool need_images = num_slots<sig_cb_real_sense_images> () > 0;
+    need_depth_image_ = need_images || num_slots<sig_cb_real_sense_depth_image> () > 0;
+    need_color_image_ = need_images || num_slots<sig_cb_real_sense_color_image> () > 0;
+    need_color_ = need_xyzrgba_ || need_color_image_;
+    if (need_xyz_ || need_xyzrgba_ || need_depth_image_ || need_color_image_)
     {
-      frequency_.reset ();
-      is_running_ = true;
+      mode_selected_ = selectMode (!need_color_);
+      frame_intervals_.reset (mode_selected_.fps ? 1000000 / mode_selected_.fps : 0);
+      const unsigned int width = mode_selected_.depth_width;
+      const unsigned int height = mode_selected_.depth_height;
       PXCCapture::Device::StreamProfileSet profile;
       memset (&profile, 0, sizeof (profile));
-      // TODO: this should depend on Mode
-      profile.depth.frameRate.max = 30;
-      profile.depth.frameRate.min = 30;
-      profile.depth.imageInfo.width = WIDTH;
-      profile.depth.imageInfo.height = HEIGHT;
+      profile.depth.frameRate.max = mode_selected_.fps;
+      profile.depth.frameRate.min = mode_selected_.fps;
+      profile.depth.imageInfo.width = width;
+      profile.depth.imageInfo.height = height;
       profile.depth.imageInfo.format = PXCImage::PIXEL_FORMAT_DEPTH;
       profile.depth.options = PXCCapture::Device::STREAM_OPTION_ANY;
-      if (need_xyzrgba_)
+      if (need_color_)
       {
-        profile.color.frameRate.max = 30;
-        profile.color.frameRate.min = 30;
-        profile.color.imageInfo.width = COLOR_WIDTH;
-        profile.color.imageInfo.height = COLOR_HEIGHT;
+        profile.color.frameRate.max = mode_selected_.fps;
+        profile.color.frameRate.min = mode_selected_.fps;
+        profile.color.imageInfo.width = mode_selected_.color_width;
+        profile.color.imageInfo.height = mode_selected_.color_height;
         profile.color.imageInfo.format = PXCImage::PIXEL_FORMAT_RGB32;
         profile.color.options = PXCCapture::Device::STREAM_OPTION_ANY;
       }
@@ -132,17 +331,82 @@ pcl::RealSenseGrabber::start ()
       if (!valid)
         THROW_IO_EXCEPTION ("invalid stream profile for PXC device");
 
+      // Ray tables only depend on the depth stream calibration (and
+      // cropping and decimation), so they are rebuilt only if that changes
+      PXCProjection* projection = device_->getPXCDevice ().CreateProjection ();
+      PXCCalibration* calib = projection->QueryInstance<PXCCalibration> ();
+      PXCCalibration::StreamCalibration depth_calib;
+      PXCCalibration::StreamTransform depth_trans;
+      calib->QueryStreamProjectionParameters (PXCCapture::STREAM_TYPE_DEPTH, &depth_calib, &depth_trans);
+      projection->Release ();
+      pcl::io::real_sense::CameraIntrinsics intrinsics (depth_calib.focalLength.x, depth_calib.focalLength.y,
+                                                        depth_calib.principalPoint.x, depth_calib.principalPoint.y);
+      std::copy (depth_calib.radialDistortion, depth_calib.radialDistortion + 3, intrinsics.radial_distortion);
+      std::copy (depth_calib.tangentialDistortion, depth_calib.tangentialDistortion + 2, intrinsics.tangential_distortion);
+      // Full resolution table is also needed with cropping and decimation to
+      // check our camera model against the SDK
+      updateRayTable (ray_table_, width, height, intrinsics);
 
-	  PXCCalibration* calib = device_->getPXCDevice().CreateProjection()->QueryInstance<PXCCalibration>();
-	  PXCCalibration::StreamCalibration depth_calib;
-	  PXCCalibration::StreamTransform depth_trans;
-	  calib->QueryStreamProjectionParameters(PXCCapture::STREAM_TYPE_DEPTH, &depth_calib, &depth_trans);
-	  std::cout << "Focal Length      : " << depth_calib.focalLength.x << ", " << depth_calib.focalLength.y << std::endl;
-	  std::cout << "Principal Point   : " << depth_calib.principalPoint.x << ", " << depth_calib.principalPoint.y << std::endl;
-	  std::cout << "Radial Distortion : " << depth_calib.radialDistortion[0] << ", " << depth_calib.radialDistortion[1] << ", " << depth_calib.radialDistortion[2] << std::endl;
-	  std::cout << "Tangent Distortion: " << depth_calib.tangentialDistortion[0] << ", " << depth_calib.tangentialDistortion[1] << std::endl;
+      crop_x_ = std::min (roi_x_, width - 1);
+      crop_y_ = std::min (roi_y_, height - 1);
+      crop_width_ = roi_width_ ? std::min (roi_width_, width - crop_x_) : width - crop_x_;
+      crop_height_ = roi_height_ ? std::min (roi_height_, height - crop_y_) : height - crop_y_;
+      output_width_ = crop_width_ / decimation_factor_;
+      output_height_ = crop_height_ / decimation_factor_;
+      if (output_width_ == 0 || output_height_ == 0)
+        THROW_IO_EXCEPTION ("region of interest (%ux%u) is smaller than decimation factor (%u)",
+                            crop_width_, crop_height_, decimation_factor_);
+      transform_depth_ = decimation_factor_ > 1 || crop_width_ != width || crop_height_ != height;
+      if (transform_depth_)
+      {
+        // Moving the principal point makes the region an image of its own
+        pcl::io::real_sense::CameraIntrinsics crop_intrinsics (intrinsics);
+        crop_intrinsics.cx -= crop_x_;
+        crop_intrinsics.cy -= crop_y_;
+        updateRayTable (output_ray_table_, output_width_, output_height_,
+                        pcl::io::real_sense::decimateIntrinsics (crop_intrinsics, decimation_factor_, decimation_method_));
+        output_depth_pool_.reset (new pcl::io::ObjectPool<std::vector<boost::uint16_t> >
+                                  (boost::bind (&createDepthImage, output_width_ * output_height_), cloud_pool_size_));
+      }
+      else
+      {
+        output_ray_table_.reset ();
+        output_depth_pool_.reset ();
+      }
+
+      // Depth images are in millimeters
+      const unsigned short min_depth = static_cast<unsigned short> (std::min (std::ceil (min_depth_ * 1000.0f), 65535.0f));
+      const unsigned short max_depth = max_depth_ > 0.0f ? static_cast<unsigned short> (std::min (std::floor (max_depth_ * 1000.0f), 65535.0f)) : 65535;
+      ray_table_->setDepthRange (min_depth, max_depth);
+      if (output_ray_table_)
+        output_ray_table_->setDepthRange (min_depth, max_depth);
+
+      createDepthBuffer ();
 
-      thread_ = boost::thread (&RealSenseGrabber::run, this);
+      // Clouds that subscribers still hold from the previous run are deleted
+      // when released
+      xyz_cloud_pool_.reset (new pcl::io::ObjectPool<pcl::PointCloud<pcl::PointXYZ> >
+                             (boost::bind (&createCloud<pcl::PointXYZ>, output_width_, output_height_), cloud_pool_size_));
+      xyzrgba_cloud_pool_.reset (new pcl::io::ObjectPool<pcl::PointCloud<pcl::PointXYZRGBA> >
+                                 (boost::bind (&createCloud<pcl::PointXYZRGBA>, output_width_, output_height_), cloud_pool_size_));
+
+      frame_queue_.reset (new pcl::io::BoundedQueue<FramePtr> (frame_queue_capacity_, frame_queue_policy_));
+      next_frame_sequence_ = 0;
+      next_filter_sequence_ = 0;
+      latency_recorder_.reset ();
+      queue_time_.reset ();
+      decimation_time_.reset ();
+      filtering_time_.reset ();
+      mapping_time_.reset ();
+      projection_time_.reset ();
+      dispatch_time_.reset ();
+      total_time_.reset ();
+      last_pipeline_stats_log_ = getMonotonicTime ();
+
+      is_running_ = true;
+      acquisition_thread_ = boost::thread (&RealSenseGrabber::run, this);
+      for (size_t i = 0; i < num_processing_threads_; ++i)
+        processing_threads_.push_back (boost::shared_ptr<boost::thread> (new boost::thread (&RealSenseGrabber::process, this)));
     }
   }
 }
@@ -153,7 +417,16 @@ pcl::RealSenseGrabber::stop ()
   if (is_running_)
   {
     is_running_ = false;
-    thread_.join ();
+    // Wake up threads waiting on the queue and discard pending frames
+    frame_queue_->close ();
+    acquisition_thread_.join ();
+    for (size_t i = 0; i < processing_threads_.size (); ++i)
+      processing_threads_[i]->join ();
+    processing_threads_.clear ();
+    // TODO: replace with a custom "restart" function?
+    std::string id = device_->getSerialNumber ();
+    device_.reset ();
+    device_ = RealSenseDeviceManager::getInstance ()->captureDevice (id);
   }
 }
 
@@ -166,8 +439,19 @@ pcl::RealSenseGrabber::isRunning () const
 float
 pcl::RealSenseGrabber::getFramesPerSecond () const
 {
-  boost::mutex::scoped_lock lock (fps_mutex_);
-  return (frequency_.getFrequency ());
+  return (frame_intervals_.getStatistics ().frequency);
+}
+
+pcl::io::IntervalStatistics
+pcl::RealSenseGrabber::getFrameIntervalStatistics () const
+{
+  return (frame_intervals_.getStatistics ());
+}
+
+size_t
+pcl::RealSenseGrabber::getNumMissedFrames () const
+{
+  return (frame_intervals_.getNumMissed ());
 }
 
 void
@@ -188,31 +472,13 @@ void
 pcl::RealSenseGrabber::enableTemporalFiltering (TemporalFilteringType type, size_t window_size)
 {
   if (temporal_filtering_type_ != type ||
-     (type != RealSense_None && depth_buffer_->size () != window_size))
+     (type != RealSense_None && temporal_filtering_window_size_ != window_size))
   {
     bool was_running = is_running_;
     if (was_running)
       stop ();
-    switch (type)
-    {
-      case RealSense_None:
-        {
-          depth_buffer_.reset (new pcl::io::SingleBuffer<unsigned short> (SIZE));
-          break;
-        }
-      case RealSense_Median:
-        {
-          // TODO: MedianFilter freezes on destructor, investigate
-          depth_buffer_.reset (new pcl::io::MedianBuffer<unsigned short> (SIZE, window_size));
-          break;
-        }
-      case RealSense_Average:
-        {
-          depth_buffer_.reset (new pcl::io::AverageBuffer<unsigned short> (SIZE, window_size));
-          break;
-        }
-    }
     temporal_filtering_type_ = type;
+    temporal_filtering_window_size_ = window_size;
     if (was_running)
       start ();
   }
@@ -224,131 +490,640 @@ pcl::RealSenseGrabber::disableTemporalFiltering ()
   enableTemporalFiltering (RealSense_None, 1);
 }
 
+void
+pcl::RealSenseGrabber::setNumFilteringThreads (size_t num_threads)
+{
+  bool was_running = is_running_;
+  if (was_running)
+    stop ();
+  if (num_threads > 1)
+    filtering_thread_pool_.reset (new pcl::io::ThreadPool (num_threads));
+  else
+    filtering_thread_pool_.reset ();
+  if (was_running)
+    start ();
+}
+
+void
+pcl::RealSenseGrabber::setMotionThreshold (float threshold)
+{
+  motion_threshold_ = threshold;
+  if (temporal_filtering_type_ == RealSense_Adaptive && is_running_)
+  {
+    stop ();
+    start ();
+  }
+}
+
+void
+pcl::RealSenseGrabber::setDecimation (unsigned int factor, pcl::io::real_sense::DecimationMethod method)
+{
+  factor = std::max (factor, 1u);
+  if (method != pcl::io::real_sense::DECIMATION_STRIDE && factor > pcl::io::real_sense::MAX_BINNING_DECIMATION_FACTOR)
+    THROW_IO_EXCEPTION ("binning supports decimation factors up to %u, requested %u",
+                        pcl::io::real_sense::MAX_BINNING_DECIMATION_FACTOR, factor);
+  bool was_running = is_running_;
+  if (was_running)
+    stop ();
+  decimation_factor_ = factor;
+  decimation_method_ = method;
+  if (was_running)
+    start ();
+}
+
+void
+pcl::RealSenseGrabber::setRegionOfInterest (unsigned int x, unsigned int y, unsigned int width, unsigned int height)
+{
+  bool was_running = is_running_;
+  if (was_running)
+    stop ();
+  roi_x_ = x;
+  roi_y_ = y;
+  roi_width_ = width;
+  roi_height_ = height;
+  if (was_running)
+    start ();
+}
+
+void
+pcl::RealSenseGrabber::setDepthRange (float min_depth, float max_depth)
+{
+  bool was_running = is_running_;
+  if (was_running)
+    stop ();
+  min_depth_ = std::max (min_depth, 0.0f);
+  max_depth_ = std::max (max_depth, 0.0f);
+  if (was_running)
+    start ();
+}
+
+void
+pcl::RealSenseGrabber::setCloudPoolSize (size_t size)
+{
+  cloud_pool_size_ = size;
+  if (xyz_cloud_pool_)
+    xyz_cloud_pool_->setMaxSize (size);
+  if (xyzrgba_cloud_pool_)
+    xyzrgba_cloud_pool_->setMaxSize (size);
+}
+
+void
+pcl::RealSenseGrabber::setMode (const Mode& mode, bool strict)
+{
+  if (mode == mode_requested_ && strict == strict_)
+    return;
+  bool was_running = is_running_;
+  if (was_running)
+    stop ();
+  mode_requested_ = mode;
+  mode_selected_ = mode;
+  strict_ = strict;
+  if (was_running)
+    start ();
+}
+
+const pcl::RealSenseGrabber::Mode&
+pcl::RealSenseGrabber::getMode () const
+{
+  return (mode_selected_);
+}
+
+std::vector<pcl::RealSenseGrabber::Mode>
+pcl::RealSenseGrabber::getAvailableModes (bool only_depth) const
+{
+  std::vector<Mode> modes;
+  PXCCapture::StreamType streams = only_depth
+    ? PXCCapture::STREAM_TYPE_DEPTH
+    : PXCCapture::STREAM_TYPE_DEPTH | PXCCapture::STREAM_TYPE_COLOR;
+  PXCCapture::Device::StreamProfileSet profiles;
+  for (int i = 0; i < device_->getPXCDevice ().QueryStreamProfileSetNum (streams); ++i)
+  {
+    memset (&profiles, 0, sizeof (profiles));
+    if (device_->getPXCDevice ().QueryStreamProfileSet (streams, i, &profiles) < PXC_STATUS_NO_ERROR)
+      break;
+    if (profiles.depth.imageInfo.format != PXCImage::PIXEL_FORMAT_DEPTH)
+      continue;
+    // Depth and color frames are processed together, so their rates should
+    // be the same
+    if (!only_depth && profiles.depth.frameRate.max != profiles.color.frameRate.max)
+      continue;
+    Mode mode (static_cast<unsigned int> (profiles.depth.frameRate.max),
+               profiles.depth.imageInfo.width,
+               profiles.depth.imageInfo.height,
+               only_depth ? 0 : profiles.color.imageInfo.width,
+               only_depth ? 0 : profiles.color.imageInfo.height);
+    if (std::find (modes.begin (), modes.end (), mode) == modes.end ())
+      modes.push_back (mode);
+  }
+  return (modes);
+}
+
+void
+pcl::RealSenseGrabber::setFrameQueue (size_t capacity, pcl::io::OverflowPolicy policy)
+{
+  bool was_running = is_running_;
+  if (was_running)
+    stop ();
+  frame_queue_capacity_ = capacity;
+  frame_queue_policy_ = policy;
+  if (was_running)
+    start ();
+}
+
+void
+pcl::RealSenseGrabber::setNumProcessingThreads (size_t num_threads)
+{
+  bool was_running = is_running_;
+  if (was_running)
+    stop ();
+  num_processing_threads_ = std::max<size_t> (num_threads, 1);
+  if (was_running)
+    start ();
+}
+
+size_t
+pcl::RealSenseGrabber::getNumCapturedFrames () const
+{
+  return (frame_queue_ ? frame_queue_->getNumPushed () : 0);
+}
+
+size_t
+pcl::RealSenseGrabber::getNumDroppedFrames () const
+{
+  return (frame_queue_ ? frame_queue_->getNumDropped () : 0);
+}
+
+pcl::io::LatencyStatistics
+pcl::RealSenseGrabber::getLatencyStatistics () const
+{
+  return (latency_recorder_.getStatistics ());
+}
+
+pcl::RealSenseGrabber::PipelineStats
+pcl::RealSenseGrabber::getPipelineStats () const
+{
+  PipelineStats stats;
+  stats.queue = queue_time_.getStatistics ();
+  stats.decimation = decimation_time_.getStatistics ();
+  stats.filtering = filtering_time_.getStatistics ();
+  stats.mapping = mapping_time_.getStatistics ();
+  stats.projection = projection_time_.getStatistics ();
+  stats.dispatch = dispatch_time_.getStatistics ();
+  stats.total = total_time_.getStatistics ();
+  return (stats);
+}
+
+void
+pcl::RealSenseGrabber::setPipelineStatsLogging (float period)
+{
+  pipeline_stats_log_period_.store (period > 0.0f ? static_cast<boost::uint64_t> (period * 1.0e+6) : 0,
+                                    boost::memory_order_relaxed);
+}
+
+void
+pcl::RealSenseGrabber::logPipelineStats ()
+{
+  const boost::uint64_t period = pipeline_stats_log_period_.load (boost::memory_order_relaxed);
+  if (period == 0)
+    return;
+  // Only one of the processing threads logs, others do not wait for it
+  boost::mutex::scoped_try_lock lock (pipeline_stats_log_mutex_);
+  if (!lock.owns_lock ())
+    return;
+  const uint64_t now = getMonotonicTime ();
+  if (now - last_pipeline_stats_log_ < period)
+    return;
+  last_pipeline_stats_log_ = now;
+  const PipelineStats stats = getPipelineStats ();
+  PCL_INFO ("[pcl::RealSenseGrabber] Pipeline mean/p99 (us): queue %.0f/%.0f, decimation %.0f/%.0f, "
+            "filtering %.0f/%.0f, mapping %.0f/%.0f, projection %.0f/%.0f, dispatch %.0f/%.0f, total %.0f/%.0f\n",
+            stats.queue.mean, static_cast<double> (stats.queue.p99),
+            stats.decimation.mean, static_cast<double> (stats.decimation.p99),
+            stats.filtering.mean, static_cast<double> (stats.filtering.p99),
+            stats.mapping.mean, static_cast<double> (stats.mapping.p99),
+            stats.projection.mean, static_cast<double> (stats.projection.p99),
+            stats.dispatch.mean, static_cast<double> (stats.dispatch.p99),
+            stats.total.mean, static_cast<double> (stats.total.p99));
+}
+
+pcl::RealSenseGrabber::AsyncPointCloudSlot::Ptr
+pcl::RealSenseGrabber::registerAsyncCallback (const boost::function<sig_cb_real_sense_point_cloud>& callback)
+{
+  return (connectAsyncSlot (*point_cloud_signal_, callback));
+}
+
+pcl::RealSenseGrabber::AsyncPointCloudRGBASlot::Ptr
+pcl::RealSenseGrabber::registerAsyncCallback (const boost::function<sig_cb_real_sense_point_cloud_rgba>& callback)
+{
+  return (connectAsyncSlot (*point_cloud_rgba_signal_, callback));
+}
+
 const std::string&
 pcl::RealSenseGrabber::getDeviceSerialNumber () const
 {
   return (device_->getSerialNumber ());
 }
 
+pcl::RealSenseGrabber::Mode
+pcl::RealSenseGrabber::selectMode (bool only_depth) const
+{
+  std::vector<Mode> modes = getAvailableModes (only_depth);
+  if (modes.empty ())
+    THROW_IO_EXCEPTION ("device does not support any capture modes");
+  // Mismatch in every field is penalized, with frame rate being the most and
+  // color resolution the least important. Zero fields match anything.
+  const Mode& r = mode_requested_;
+  size_t best = 0;
+  double best_penalty = std::numeric_limits<double>::max ();
+  for (size_t i = 0; i < modes.size (); ++i)
+  {
+    const Mode& m = modes[i];
+    double penalty = 0.0;
+    if (r.fps)
+      penalty += 1.0e6 * std::abs (static_cast<double> (m.fps) - r.fps);
+    if (r.depth_width && r.depth_height)
+      penalty += 1.0e3 * std::abs (static_cast<double> (m.depth_width) * m.depth_height - static_cast<double> (r.depth_width) * r.depth_height);
+    if (!only_depth && r.color_width && r.color_height)
+      penalty += 1.0e-3 * std::abs (static_cast<double> (m.color_width) * m.color_height - static_cast<double> (r.color_width) * r.color_height);
+    if (strict_)
+    {
+      bool match = (!r.fps || m.fps == r.fps) &&
+                   (!r.depth_width || m.depth_width == r.depth_width) &&
+                   (!r.depth_height || m.depth_height == r.depth_height) &&
+                   (only_depth || !r.color_width || m.color_width == r.color_width) &&
+                   (only_depth || !r.color_height || m.color_height == r.color_height);
+      if (!match)
+        continue;
+    }
+    if (penalty < best_penalty)
+    {
+      best = i;
+      best_penalty = penalty;
+    }
+  }
+  if (best_penalty == std::numeric_limits<double>::max ())
+    THROW_IO_EXCEPTION ("device does not support requested capture mode (%u Hz, depth %ux%u, color %ux%u)",
+                        r.fps, r.depth_width, r.depth_height, r.color_width, r.color_height);
+  return (modes[best]);
+}
+
+void
+pcl::RealSenseGrabber::createDepthBuffer ()
+{
+  const size_t size = output_width_ * output_height_;
+  const size_t window_size = temporal_filtering_window_size_;
+  switch (temporal_filtering_type_)
+  {
+    case RealSense_None:
+      {
+        depth_buffer_.reset (new pcl::io::SingleBuffer<unsigned short> (size));
+        break;
+      }
+    case RealSense_Median:
+      {
+        // Small windows are served by sorting networks that are much faster
+        // than the generic implementation
+        switch (window_size)
+        {
+          case 3:
+            depth_buffer_.reset (new pcl::io::FixedMedianBuffer<unsigned short, 3> (size));
+            break;
+          case 5:
+            depth_buffer_.reset (new pcl::io::FixedMedianBuffer<unsigned short, 5> (size));
+            break;
+          case 7:
+            depth_buffer_.reset (new pcl::io::FixedMedianBuffer<unsigned short, 7> (size));
+            break;
+          default:
+            // MedianBuffer is limited to 255 frames, histograms take no
+            // longer for larger windows but use much more memory
+            if (window_size <= 255)
+              depth_buffer_.reset (new pcl::io::MedianBuffer<unsigned short> (size, window_size));
+            else
+              depth_buffer_.reset (new pcl::io::HistogramMedianBuffer (size, window_size));
+            break;
+        }
+        break;
+      }
+    case RealSense_Average:
+      {
+        depth_buffer_.reset (new pcl::io::AverageBuffer<unsigned short> (size, window_size));
+        break;
+      }
+    case RealSense_Exponential:
+      {
+        float alpha = 2.0f / (window_size + 1);
+        depth_buffer_.reset (new pcl::io::ExponentialBuffer<unsigned short> (size, alpha, window_size));
+        break;
+      }
+    case RealSense_Adaptive:
+      {
+        depth_buffer_.reset (new pcl::io::AdaptiveBuffer<unsigned short> (size, window_size, motion_threshold_));
+        break;
+      }
+  }
+  depth_buffer_->setThreadPool (filtering_thread_pool_);
+}
+
 void
 pcl::RealSenseGrabber::run ()
 {
-  PXCProjection* projection = device_->getPXCDevice ().CreateProjection ();
   PXCCapture::Sample sample;
-  std::vector<PXCPoint3DF32> vertices (SIZE);
+  setTraceThreadName ("RealSenseGrabber acquisition");
 
   while (is_running_)
   {
-    pcl::PointCloud<pcl::PointXYZ>::Ptr xyz_cloud;
-    pcl::PointCloud<pcl::PointXYZRGBA>::Ptr xyzrgba_cloud;
-
     pxcStatus status;
-    if (need_xyzrgba_)
-      status = device_->getPXCDevice ().ReadStreams (PXCCapture::STREAM_TYPE_DEPTH | PXCCapture::STREAM_TYPE_COLOR, &sample);
-    else
-      status = device_->getPXCDevice ().ReadStreams (PXCCapture::STREAM_TYPE_DEPTH, &sample);
+    {
+      PCL_REAL_SENSE_TRACE_SCOPE ("ReadStreams");
+      if (need_color_)
+        status = device_->getPXCDevice ().ReadStreams (PXCCapture::STREAM_TYPE_DEPTH | PXCCapture::STREAM_TYPE_COLOR, &sample);
+      else
+        status = device_->getPXCDevice ().ReadStreams (PXCCapture::STREAM_TYPE_DEPTH, &sample);
+    }
+
+    const uint64_t arrival = getSystemTime ();
 
-    uint64_t timestamp = pcl::getTime () * 1.0e+6;
-    
     switch (status)
     {
     case PXC_STATUS_NO_ERROR:
     {
-      fps_mutex_.lock ();
-      frequency_.event ();
-      fps_mutex_.unlock ();
-
-      /* We preform the following steps to convert received data into point clouds:
-       * 
-       *   1. Push depth image to the depth buffer
-       *   2. Pull filtered depth image from the depth buffer
-       *   3. Project (filtered) depth image into 3D
-       *   4. Fill XYZ point cloud with computed points
-       *   5. Fill XYZRGBA point cloud with computed points
-       *   7. Project color image into 3D
-       *   6. Assign colors to points in XYZRGBA point cloud
-       *
-       * Steps 1-2 are skipped if temporal filtering is disabled.
-       * Step 4 is skipped if there are no subscribers for XYZ clouds.
-       * Steps 5-7 are skipped if there are no subscribers for XYZRGBA clouds. */
-
-      if (temporal_filtering_type_ != RealSense_None)
+      // Stamp frames with the time the sensor captured them rather than the
+      // time they came out of the SDK, which varies with SDK queueing. Fall
+      // back to the arrival time for images without a time stamp.
+      const pxcI64 time_stamp = sample.depth->QueryTimeStamp ();
+      const uint64_t timestamp = time_stamp > PXC_TIME_STAMP_UNIX_EPOCH ? toMicroseconds (time_stamp) : arrival;
+      frame_intervals_.record (timestamp);
+      // Depending on the policy the frame (or an older one) may be dropped
+      // here, which releases its images
+      PCL_REAL_SENSE_TRACE_SCOPE ("queue push");
+      frame_queue_->push (FramePtr (new Frame (sample, timestamp)));
+      break;
+    }
+    case PXC_STATUS_DEVICE_LOST:
+      THROW_IO_EXCEPTION ("failed to read data stream from PXC device: device lost");
+    case PXC_STATUS_ALLOC_FAILED:
+      THROW_IO_EXCEPTION ("failed to read data stream from PXC device: alloc failed");
+    }
+    sample.ReleaseImages ();
+  }
+}
+
+void
+pcl::RealSenseGrabber::process ()
+{
+  const bool need_clouds = need_xyz_ || need_xyzrgba_;
+  PXCProjection* projection = need_clouds ? device_->getPXCDevice ().CreateProjection () : 0;
+  const unsigned int width = mode_selected_.depth_width;
+  const unsigned int height = mode_selected_.depth_height;
+  const unsigned int factor = decimation_factor_;
+  const bool transform = transform_depth_;
+  const unsigned int offset = pcl::io::real_sense::getDecimationOffset (factor, decimation_method_);
+  // Index of the first pixel of the region of interest in full images
+  const unsigned int crop_start = crop_y_ * width + crop_x_;
+  const int size = output_width_ * output_height_;
+  const pcl::io::real_sense::RayTable& ray_table = transform ? *output_ray_table_ : *ray_table_;
+  std::vector<PXCPoint3DF32> vertices (need_clouds ? width * height : 0);
+  // Colors and vertices sampled at output resolution
+  std::vector<uint32_t> output_color (need_clouds && transform ? size : 0);
+  std::vector<PXCPoint3DF32> output_vertices (need_clouds && transform ? size : 0);
+  bool ray_table_checked = false;
+  bool use_ray_table = true;
+  FramePtr frame;
+  setTraceThreadName ("RealSenseGrabber processing");
+
+  while (true)
+  {
+    {
+      boost::mutex::scoped_lock lock (pop_mutex_);
+      if (!frame_queue_->pop (frame))
+        break;
+      frame->sequence = next_frame_sequence_++;
+    }
+
+    PCL_REAL_SENSE_TRACE_SCOPE ("frame");
+
+    // Stage durations are measured from this point on
+    uint64_t stage_start = getMonotonicTime ();
+    const uint64_t processing_start = stage_start;
+    queue_time_.record (stage_start - frame->queued);
+
+    pcl::PointCloud<pcl::PointXYZ>::Ptr xyz_cloud;
+    pcl::PointCloud<pcl::PointXYZRGBA>::Ptr xyzrgba_cloud;
+    DepthImage::ConstPtr depth_image_view;
+    ColorImage::ConstPtr color_image_view;
+    PXCImage* depth_image = frame->depth;
+    const uint64_t timestamp = frame->timestamp;
+
+    /* We preform the following steps to convert received data into point clouds:
+     * 
+     *   1. Crop and decimate depth image
+     *   2. Push (cropped) depth image to the depth buffer
+     *   3. Pull filtered depth image from the depth buffer
+     *   4. Map color image to depth image
+     *   5. Project (filtered) depth image into 3D, filling XYZ and XYZRGBA
+     *      point clouds in a single pass
+     *
+     * Step 1 is skipped if neither region of interest nor decimation are
+     * set, otherwise the following steps work with a cropped and decimated
+     * copy of the depth image.
+     * Steps 2-3 are skipped if temporal filtering is disabled.
+     * Step 4 is skipped if there are no subscribers for XYZRGBA clouds.
+     * Steps 4-5 are skipped if there are only subscribers for images. */
+
+    boost::shared_ptr<std::vector<boost::uint16_t> > output_depth;
+    if (transform)
+    {
+      PCL_REAL_SENSE_TRACE_SCOPE ("decimation");
+      output_depth = output_depth_pool_->acquire ();
+      PXCImage::ImageData data;
+      depth_image->AcquireAccess (PXCImage::ACCESS_READ, &data);
+      pcl::io::real_sense::decimateDepth (reinterpret_cast<const boost::uint16_t*> (data.planes[0]) + crop_start,
+                                          crop_width_, crop_height_, factor, decimation_method_,
+                                          output_depth->data (), width);
+      depth_image->ReleaseAccess (&data);
+      recordStage (decimation_time_, stage_start);
+    }
+
+    if (temporal_filtering_type_ != RealSense_None)
+    {
+      boost::mutex::scoped_lock lock (filter_mutex_);
+      {
+        PCL_REAL_SENSE_TRACE_SCOPE ("filter wait");
+        while (next_filter_sequence_ != frame->sequence)
+          filter_turn_.wait (lock);
+      }
+      stage_start = getMonotonicTime ();
+
+      if (transform)
+      {
+        {
+          PCL_REAL_SENSE_TRACE_SCOPE ("filter push");
+          depth_buffer_->push (output_depth->data ());
+        }
+        PCL_REAL_SENSE_TRACE_SCOPE ("filter pull");
+        depth_buffer_->copyTo (output_depth->data ());
+      }
+      else
       {
         PXCImage::ImageData data;
-        sample.depth->AcquireAccess (PXCImage::ACCESS_READ, &data);
-        std::vector<unsigned short> data_copy (SIZE);
-        memcpy (data_copy.data (), data.planes[0], SIZE * sizeof (unsigned short));
-        sample.depth->ReleaseAccess (&data);
-
-        depth_buffer_->push (data_copy);
-
-        sample.depth->AcquireAccess (PXCImage::ACCESS_WRITE, &data);
-        unsigned short* d = reinterpret_cast<unsigned short*> (data.planes[0]);
-        for (size_t i = 0; i < SIZE; i++)
-          d[i] = (*depth_buffer_)[i];
-        sample.depth->ReleaseAccess (&data);
+        {
+          PCL_REAL_SENSE_TRACE_SCOPE ("filter push");
+          depth_image->AcquireAccess (PXCImage::ACCESS_READ, &data);
+          depth_buffer_->push (reinterpret_cast<const unsigned short*> (data.planes[0]));
+          depth_image->ReleaseAccess (&data);
+        }
+        PCL_REAL_SENSE_TRACE_SCOPE ("filter pull");
+        depth_image->AcquireAccess (PXCImage::ACCESS_WRITE, &data);
+        depth_buffer_->copyTo (reinterpret_cast<unsigned short*> (data.planes[0]));
+        depth_image->ReleaseAccess (&data);
       }
 
-      projection->QueryVertices (sample.depth, vertices.data ());
+      ++next_filter_sequence_;
+      filter_turn_.notify_all ();
+      recordStage (filtering_time_, stage_start);
+    }
 
-      if (need_xyz_)
+    // Images reference the frame (or the cropped copy), which is released
+    // together with the last of them
+    if (need_depth_image_)
+    {
+      if (transform)
+        depth_image_view.reset (new DepthImage (output_depth->data (), output_width_, output_height_,
+                                                output_width_ * sizeof (boost::uint16_t), timestamp, output_depth));
+      else
+        depth_image_view = createImage<boost::uint16_t> (frame, depth_image, PXCImage::PIXEL_FORMAT_DEPTH, timestamp);
+    }
+    if (need_color_image_)
+      color_image_view = createImage<boost::uint32_t> (frame, frame->color, PXCImage::PIXEL_FORMAT_RGB32, timestamp);
+
+    if (need_clouds)
+    {
+      PCL_REAL_SENSE_TRACE_SCOPE ("projection");
+      stage_start = getMonotonicTime ();
+      PXCImage::ImageData depth_data;
+      depth_image->AcquireAccess (PXCImage::ACCESS_READ, &depth_data);
+      const unsigned short* full_depth = reinterpret_cast<const unsigned short*> (depth_data.planes[0]);
+      const unsigned short* depth = transform ? output_depth->data () : full_depth;
+
+      if (!ray_table_checked)
       {
-        xyz_cloud.reset (new pcl::PointCloud<pcl::PointXYZ> (WIDTH, HEIGHT));
-        xyz_cloud->header.stamp = timestamp;
-        xyz_cloud->is_dense = false;
-        for (int i = 0; i < SIZE; i++)
-          convertPoint (vertices[i], xyz_cloud->points[i]);
+        // Make sure that our camera model agrees with the SDK before relying
+        // on it, otherwise fall back to (much slower) QueryVertices
+        projection->QueryVertices (depth_image, vertices.data ());
+        float deviation = computeRayTableDeviation (*ray_table_, full_depth, vertices);
+        use_ray_table = deviation < MAX_RAY_TABLE_DEVIATION;
+        if (!use_ray_table)
+          PCL_WARN ("[pcl::RealSenseGrabber::process] Projection with depth stream calibration deviates from SDK by %.4f m, falling back to QueryVertices\n", deviation);
+        ray_table_checked = true;
+      }
+      else if (!use_ray_table)
+      {
+        projection->QueryVertices (depth_image, vertices.data ());
       }
 
+      PXCImage* mapped = 0;
+      PXCImage::ImageData color_data;
+      const uint32_t* color = 0;
+      uint64_t mapping_time = 0;
       if (need_xyzrgba_)
       {
-        PXCImage::ImageData data;
-        PXCImage* mapped = projection->CreateColorImageMappedToDepth (sample.depth, sample.color);
-        
-		mapped->AcquireAccess (PXCImage::ACCESS_READ, &data);
-        uint32_t* d = reinterpret_cast<uint32_t*> (data.planes[0]);
-        if (need_xyz_)
+        PCL_REAL_SENSE_TRACE_SCOPE ("color mapping");
+        const uint64_t mapping_start = getMonotonicTime ();
+        mapped = projection->CreateColorImageMappedToDepth (depth_image, frame->color);
+        mapped->AcquireAccess (PXCImage::ACCESS_READ, &color_data);
+        color = reinterpret_cast<const uint32_t*> (color_data.planes[0]);
+        if (transform)
         {
-          // We can fill XYZ coordinates more efficiently using pcl::copyPointCloud,
-          // given that they were already computed for XYZ point cloud.
-          xyzrgba_cloud.reset (new pcl::PointCloud<pcl::PointXYZRGBA>);
-          pcl::copyPointCloud (*xyz_cloud, *xyzrgba_cloud);
-          for (int i = 0; i < SIZE; i++)
-          {
-            memcpy (&xyzrgba_cloud->points[i].rgba, &d[i], sizeof (uint32_t));
-          }
+          pcl::io::real_sense::subsample (color + crop_start, crop_width_, crop_height_, factor, offset, output_color.data (), width);
+          color = output_color.data ();
         }
+        mapping_time = getMonotonicTime () - mapping_start;
+        mapping_time_.record (mapping_time);
+        xyzrgba_cloud = xyzrgba_cloud_pool_->acquire ();
+        xyzrgba_cloud->header.stamp = timestamp;
+      }
+      if (need_xyz_)
+      {
+        xyz_cloud = xyz_cloud_pool_->acquire ();
+        xyz_cloud->header.stamp = timestamp;
+      }
+
+      // Both clouds are filled in a single pass over depth (and color) data
+      if (use_ray_table)
+      {
+        if (need_xyz_ && need_xyzrgba_)
+          ray_table.project (depth, color, &xyz_cloud->points[0], &xyzrgba_cloud->points[0]);
+        else if (need_xyz_)
+          ray_table.project (depth, &xyz_cloud->points[0]);
         else
+          ray_table.project (depth, color, &xyzrgba_cloud->points[0]);
+      }
+      else
+      {
+        // The SDK only projects full images, so with decimation vertices are
+        // sampled at block centers, and neither binning nor temporal
+        // filtering have an effect
+        BOOST_STATIC_ASSERT (sizeof (PXCPoint3DF32) == 3 * sizeof (float));
+        if (transform)
+          pcl::io::real_sense::subsample (vertices.data () + crop_start, crop_width_, crop_height_, factor, offset, output_vertices.data (), width);
+        PXCPoint3DF32* vertex = transform ? output_vertices.data () : vertices.data ();
+        // Zero depth marks vertices outside of the depth range as invalid
+        for (int i = 0; i < size; i++)
+          if (vertex[i].z < ray_table.getMinDepth () || vertex[i].z > ray_table.getMaxDepth ())
+            vertex[i].z = 0;
+        const float* v = reinterpret_cast<const float*> (vertex);
+        if (need_xyz_)
+          pcl::io::real_sense::convertVertices (v, &xyz_cloud->points[0], size);
+        if (need_xyzrgba_)
         {
-          xyzrgba_cloud.reset (new pcl::PointCloud<pcl::PointXYZRGBA> (WIDTH, HEIGHT));
-          xyzrgba_cloud->header.stamp = timestamp;
-          xyzrgba_cloud->is_dense = false;
-          for (int i = 0; i < SIZE; i++)
-          {
-            convertPoint (vertices[i], xyzrgba_cloud->points[i]);
-            memcpy (&xyzrgba_cloud->points[i].rgba, &d[i], sizeof (uint32_t));
-          }
+          pcl::io::real_sense::convertVertices (v, &xyzrgba_cloud->points[0], size);
+          for (int i = 0; i < size; i++)
+            xyzrgba_cloud->points[i].rgba = color[i];
         }
-        mapped->ReleaseAccess (&data);
+      }
+
+      if (need_xyzrgba_)
+      {
+        mapped->ReleaseAccess (&color_data);
         mapped->Release ();
       }
+      depth_image->ReleaseAccess (&depth_data);
+
+      // Everything in this block but color mapping counts as projection
+      const uint64_t now = getMonotonicTime ();
+      projection_time_.record (now - stage_start - mapping_time);
+      stage_start = now;
+    }
 
+    // Images are given back to the SDK once the frame is not referenced
+    // anymore
+    frame.reset ();
+
+    // Guard against device time stamps that are slightly ahead of the system
+    // clock
+    const uint64_t now = getSystemTime ();
+    latency_recorder_.record (now > timestamp ? now - timestamp : 0);
+
+    stage_start = getMonotonicTime ();
+    {
+      PCL_REAL_SENSE_TRACE_SCOPE ("dispatch");
+      if (depth_image_view)
+        depth_image_signal_->operator () (depth_image_view);
+      if (color_image_view)
+        color_image_signal_->operator () (color_image_view);
+      if (depth_image_view && color_image_view)
+        images_signal_->operator () (depth_image_view, color_image_view);
       if (need_xyzrgba_)
         point_cloud_rgba_signal_->operator () (xyzrgba_cloud);
       if (need_xyz_)
         point_cloud_signal_->operator () (xyz_cloud);
-      break;
     }
-    case PXC_STATUS_DEVICE_LOST:
-      THROW_IO_EXCEPTION ("failed to read data stream from PXC device: device lost");
-    case PXC_STATUS_ALLOC_FAILED:
-      THROW_IO_EXCEPTION ("failed to read data stream from PXC device: alloc failed");
-    }
-    sample.ReleaseImages ();
+
+    recordStage (dispatch_time_, stage_start);
+    total_time_.record (stage_start - processing_start);
+    logPipelineStats ();
   }
-  projection->Release ();
-  // TODO: replace with a custom "restart" function?
-  std::string id = device_->getSerialNumber ();
-  device_.reset ();
-  device_ = RealSenseDeviceManager::getInstance ()->captureDevice (id);
+  if (projection)
+    projection->Release ();
 }
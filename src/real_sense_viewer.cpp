@@ -50,6 +50,7 @@
 #include <pcl/io/pcd_io.h>
 
 #include "real_sense_grabber.h"
+#include "real_sense/trace.h"
 #include "real_sense/real_sense_device_manager.h" // TODO: remove afterwards
 
 using namespace pcl::console;
@@ -69,8 +70,11 @@ printHelp (int, char **argv)
   std::cout << "Options:" << std::endl;
   std::cout << std::endl;
   std::cout << "     --help, -h : Show this help"                                             << std::endl;
-  std::cout << "     --list, -l : List connected RealSense devices"                           << std::endl;
+  std::cout << "     --list, -l : List connected RealSense devices and supported modes"       << std::endl;
+  std::cout << "     --mode <id>: Use capture mode <id> from the list of supported modes"     << std::endl;
   std::cout << "     --xyz      : View XYZ-only clouds"                                       << std::endl;
+  std::cout << "     --trace <file>: Record a timeline of grabber and viewer activity and"    << std::endl;
+  std::cout << "                     write it to <file> (Chrome trace format) on exit"        << std::endl;
   std::cout << std::endl;
   std::cout << "Keyboard commands:"                                                           << std::endl;
   std::cout << std::endl;
@@ -82,6 +86,7 @@ printHelp (int, char **argv)
   std::cout << "     * a/A : increase or decrease bilateral filter spatial sigma"             << std::endl;
   std::cout << "     * z/Z : increase or decrease bilateral filter range sigma"               << std::endl;
   std::cout << "     * s   : save the last grabbed cloud to disk"                             << std::endl;
+  std::cout << "     * y   : write the trace recorded so far (with --trace)"                  << std::endl;
   std::cout << "     * h   : print the list of standard PCL viewer commands"                  << std::endl;
   std::cout << std::endl;
   std::cout << "Notes:"                                                                       << std::endl;
@@ -93,6 +98,19 @@ printHelp (int, char **argv)
   std::cout << std::endl;
   std::cout << "   If device_id is not given, then the first available device will be used."  << std::endl;
   std::cout << std::endl;
+  std::cout << "   Supported modes are different for XYZ-only clouds (depth stream only) and"  << std::endl;
+  std::cout << "   XYZRGBA clouds (depth and color streams), so --mode should be used together" << std::endl;
+  std::cout << "   with --xyz if the mode was listed as a depth-only one."                    << std::endl;
+  std::cout << std::endl;
+}
+
+void
+printMode (const pcl::RealSenseGrabber::Mode& mode)
+{
+  std::cout << boost::format ("%3u Hz, depth %4ux%-4u") % mode.fps % mode.depth_width % mode.depth_height;
+  if (mode.color_width)
+    std::cout << boost::format (", color %4ux%-4u") % mode.color_width % mode.color_height;
+  std::cout << std::endl;
 }
 
 void
@@ -108,6 +126,17 @@ printDeviceList ()
     {
       grabbers.push_back (RealSenseGrabberPtr (new pcl::RealSenseGrabber));
       std::cout << boost::str (fmt % grabbers.size () % grabbers.back ()->getDeviceSerialNumber ());
+      const char* titles[] = { "Depth and color modes:", "Depth-only modes (use with --xyz):" };
+      for (int only_depth = 0; only_depth < 2; ++only_depth)
+      {
+        std::vector<pcl::RealSenseGrabber::Mode> modes = grabbers.back ()->getAvailableModes (only_depth);
+        std::cout << "\n      " << titles[only_depth] << std::endl;
+        for (size_t i = 0; i < modes.size (); ++i)
+        {
+          std::cout << boost::format ("        %2i) ") % i;
+          printMode (modes[i]);
+        }
+      }
     }
     catch (pcl::io::IOException& e)
     {
@@ -128,8 +157,9 @@ class RealSenseViewer
 
     typedef pcl::PointCloud<PointT> PointCloudT;
 
-    RealSenseViewer (pcl::RealSenseGrabber& grabber)
+    RealSenseViewer (pcl::RealSenseGrabber& grabber, const std::string& trace_filename = "")
     : grabber_ (grabber)
+    , trace_filename_ (trace_filename)
     , viewer_ ("RealSense Viewer")
     , window_ (3)
     , threshold_ (6)
@@ -145,17 +175,22 @@ class RealSenseViewer
 
     ~RealSenseViewer ()
     {
-      connection_.disconnect ();
+      // Stop the worker thread before the viewer goes away
+      slot_.reset ();
     }
 
     void
     run ()
     {
+      // Filtering and saving clouds is slow, so do it on a separate thread
+      // and let the grabber skip clouds rather than wait for us
       boost::function<void (const typename PointCloudT::ConstPtr&)> f = boost::bind (&RealSenseViewer::cloudCallback, this, _1);
-      connection_ = grabber_.registerCallback (f);
+      slot_ = grabber_.registerAsyncCallback (f);
+      pcl::io::real_sense::setTraceThreadName ("viewer");
       grabber_.start ();
       while (!viewer_.wasStopped ())
       {
+        PCL_REAL_SENSE_TRACE_SCOPE ("render");
         if (new_cloud_)
         {
           boost::mutex::scoped_lock lock (new_cloud_mutex_);
@@ -171,6 +206,7 @@ class RealSenseViewer
         viewer_.spinOnce (1, true);
       }
       grabber_.stop ();
+      writeTrace ();
     }
 
   private:
@@ -178,11 +214,13 @@ class RealSenseViewer
     void
     cloudCallback (typename PointCloudT::ConstPtr cloud)
     {
+      pcl::io::real_sense::setTraceThreadName ("viewer callback");
       if (!viewer_.wasStopped ())
       {
         boost::mutex::scoped_lock lock (new_cloud_mutex_);
         if (with_bilateral_)
         {
+          PCL_REAL_SENSE_TRACE_SCOPE ("bilateral filter");
           bilateral_.setInputCloud (cloud);
           typename PointCloudT::Ptr filtered (new PointCloudT);
           bilateral_.filter (*filtered);
@@ -232,18 +270,30 @@ class RealSenseViewer
           switch (temporal_filtering_)
           {
             case pcl::RealSenseGrabber::RealSense_None:
-              //{
-                //temporal_filtering_ = pcl::RealSenseGrabber::RealSense_Median;
-                //pcl::console::print_value ("median\n");
-                //break;
-              //}
-            //case pcl::RealSenseGrabber::RealSense_Median:
+              {
+                temporal_filtering_ = pcl::RealSenseGrabber::RealSense_Median;
+                pcl::console::print_value ("median\n");
+                break;
+              }
+            case pcl::RealSenseGrabber::RealSense_Median:
               {
                 temporal_filtering_ = pcl::RealSenseGrabber::RealSense_Average;
                 pcl::console::print_value ("average\n");
                 break;
               }
             case pcl::RealSenseGrabber::RealSense_Average:
+              {
+                temporal_filtering_ = pcl::RealSenseGrabber::RealSense_Exponential;
+                pcl::console::print_value ("exponential\n");
+                break;
+              }
+            case pcl::RealSenseGrabber::RealSense_Exponential:
+              {
+                temporal_filtering_ = pcl::RealSenseGrabber::RealSense_Adaptive;
+                pcl::console::print_value ("adaptive\n");
+                break;
+              }
+            case pcl::RealSenseGrabber::RealSense_Adaptive:
               {
                 temporal_filtering_ = pcl::RealSenseGrabber::RealSense_None;
                 pcl::console::print_value ("none\n");
@@ -282,6 +332,7 @@ class RealSenseViewer
         {
           boost::format fmt ("RS_%s_%u.pcd");
           std::string fn = boost::str (fmt % grabber_.getDeviceSerialNumber ().c_str () % last_cloud_->header.stamp);
+          PCL_REAL_SENSE_TRACE_SCOPE ("save PCD");
           pcl::io::savePCDFileBinaryCompressed (fn, *last_cloud_);
           pcl::console::print_info ("Saved point cloud: ");
           pcl::console::print_value (fn.c_str ());
@@ -303,10 +354,29 @@ class RealSenseViewer
 			}
 			
 		}
+        if (event.getKeyCode () == 'y')
+          writeTrace ();
         displaySettings ();
       }
     }
 
+    void
+    writeTrace ()
+    {
+      if (trace_filename_.empty ())
+        return;
+      if (pcl::io::real_sense::writeChromeTrace (trace_filename_))
+      {
+        pcl::console::print_info ("Saved trace: ");
+        pcl::console::print_value (trace_filename_.c_str ());
+        pcl::console::print_info ("\n");
+      }
+      else
+      {
+        pcl::console::print_error ("Failed to write trace to %s\n", trace_filename_.c_str ());
+      }
+    }
+
 	void createStreamDirectory()
 	{
 		std::stringstream ss;
@@ -321,6 +391,7 @@ class RealSenseViewer
 	
 	void savePointCloud(typename PointCloudT::ConstPtr cloud)
 	{
+		PCL_REAL_SENSE_TRACE_SCOPE ("save PCD");
 		std::stringstream ss;
 		ss << std::setfill('0') << std::setw(4) << stream_id_ << "/" << std::setfill('0') << std::setw(4) << frame_id_ << ".pcd";
 		pcl::io::savePCDFileBinaryCompressed(ss.str(), *cloud);
@@ -333,10 +404,18 @@ class RealSenseViewer
       const int dy = 14;
       const int fs = 10;
       boost::format name_fmt ("text%i");
-      const char* TF[] = {"off", "median", "average"};
+      const char* TF[] = {"off", "median", "average", "exponential", "adaptive"};
       std::vector<boost::format> entries;
       // Framerate
-      entries.push_back (boost::format ("framerate: %.1f") % grabber_.getFramesPerSecond ());
+      pcl::io::IntervalStatistics intervals = grabber_.getFrameIntervalStatistics ();
+      entries.push_back (boost::format ("framerate: %.1f (jitter %.1f ms, %u frames missed)")
+                         % intervals.frequency % (intervals.jitter * 0.001) % grabber_.getNumMissedFrames ());
+      // Clouds processed by the viewer and skipped because it was busy
+      entries.push_back (boost::format ("clouds: %u processed, %u skipped") % slot_->getNumDelivered () % slot_->getNumSkipped ());
+      // Time from capture by the sensor to the grabber callbacks
+      pcl::io::LatencyStatistics latency = grabber_.getLatencyStatistics ();
+      entries.push_back (boost::format ("latency: %.1f ms mean, %.1f ms p50, %.1f ms p99")
+                         % (latency.mean * 0.001) % (latency.p50 * 0.001) % (latency.p99 * 0.001));
       // Confidence threshold
       entries.push_back (boost::format ("confidence threshold: %i") % threshold_);
       // Temporal filter settings
@@ -357,8 +436,10 @@ class RealSenseViewer
     }
 
     pcl::RealSenseGrabber& grabber_;
+    /// Where to write the trace, empty if tracing is disabled
+    std::string trace_filename_;
     pcl::visualization::PCLVisualizer viewer_;
-    boost::signals2::connection connection_;
+    typename pcl::io::AsyncSlot<typename PointCloudT::ConstPtr>::Ptr slot_;
 
     pcl::FastBilateralFilter<PointT> bilateral_;
 
@@ -396,10 +477,20 @@ main (int argc, char** argv)
 
   bool xyz_only = find_switch (argc, argv, "--xyz");
 
+  int mode_id = -1;
+  parse_argument (argc, argv, "--mode", mode_id);
+
+  std::string trace_filename;
+  parse_argument (argc, argv, "--trace", trace_filename);
+  if (!trace_filename.empty ())
+    pcl::io::real_sense::setTracingEnabled (true);
+
   std::string device_id;
 
-  if (argc == 1 ||             // no arguments
-     (argc == 2 && xyz_only))  // single argument, and it is --xyz
+  // Device id is the last argument, if there is anything besides options
+  int num_option_args = (xyz_only ? 1 : 0) + (find_argument (argc, argv, "--mode") != -1 ? 2 : 0)
+                      + (find_argument (argc, argv, "--trace") != -1 ? 2 : 0);
+  if (argc - 1 == num_option_args)
   {
     device_id = "";
     print_info ("Creating a grabber for the first available device\n");
@@ -413,14 +504,26 @@ main (int argc, char** argv)
   try
   {
     pcl::RealSenseGrabber grabber (device_id);
+    if (mode_id != -1)
+    {
+      std::vector<pcl::RealSenseGrabber::Mode> modes = grabber.getAvailableModes (xyz_only);
+      if (mode_id < 0 || mode_id >= static_cast<int> (modes.size ()))
+      {
+        print_error ("Mode %i is not supported by the device, run with --list to see supported modes\n", mode_id);
+        return (1);
+      }
+      grabber.setMode (modes[mode_id], true);
+      print_info ("Capture mode: ");
+      printMode (modes[mode_id]);
+    }
     if (xyz_only)
     {
-      RealSenseViewer<pcl::PointXYZ> viewer (grabber);
+      RealSenseViewer<pcl::PointXYZ> viewer (grabber, trace_filename);
       viewer.run ();
     }
     else
     {
-      RealSenseViewer<pcl::PointXYZRGBA> viewer (grabber);
+      RealSenseViewer<pcl::PointXYZRGBA> viewer (grabber, trace_filename);
       viewer.run ();
     }
   }
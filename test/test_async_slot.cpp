@@ -0,0 +1,169 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "async_slot.h"
+
+using namespace pcl::io;
+
+/* Callback that records items and can be held inside the call until the
+ * gate is opened. */
+struct Recorder
+{
+  Recorder (bool gate_open = true)
+  : gate_open (gate_open)
+  {
+  }
+
+  void
+  callback (int item)
+  {
+    boost::mutex::scoped_lock lock (mutex);
+    items.push_back (item);
+    changed.notify_all ();
+    while (!gate_open)
+      changed.wait (lock);
+  }
+
+  void
+  waitForItems (size_t num_items)
+  {
+    boost::mutex::scoped_lock lock (mutex);
+    while (items.size () < num_items)
+      changed.wait (lock);
+  }
+
+  void
+  openGate ()
+  {
+    boost::mutex::scoped_lock lock (mutex);
+    gate_open = true;
+    changed.notify_all ();
+  }
+
+  boost::mutex mutex;
+  boost::condition_variable changed;
+  std::vector<int> items;
+  bool gate_open;
+};
+
+TEST (AsyncSlotTest, DeliversItems)
+{
+  Recorder recorder;
+  AsyncSlot<int> slot (boost::bind (&Recorder::callback, &recorder, _1));
+  for (int i = 0; i < 3; ++i)
+  {
+    slot.post (i);
+    recorder.waitForItems (i + 1);
+  }
+  slot.stop ();
+  ASSERT_EQ (3, recorder.items.size ());
+  for (int i = 0; i < 3; ++i)
+    EXPECT_EQ (i, recorder.items[i]);
+  EXPECT_EQ (3, slot.getNumDelivered ());
+  EXPECT_EQ (0, slot.getNumSkipped ());
+}
+
+TEST (AsyncSlotTest, SkipsStaleItems)
+{
+  Recorder recorder (false);
+  AsyncSlot<int> slot (boost::bind (&Recorder::callback, &recorder, _1));
+  slot.post (0);
+  recorder.waitForItems (1);
+  // The callback is busy, so these do not block and only the last one is kept
+  for (int i = 1; i <= 100; ++i)
+    slot.post (i);
+  EXPECT_EQ (99, slot.getNumSkipped ());
+  recorder.openGate ();
+  recorder.waitForItems (2);
+  slot.stop ();
+  ASSERT_EQ (2, recorder.items.size ());
+  EXPECT_EQ (0, recorder.items[0]);
+  EXPECT_EQ (100, recorder.items[1]);
+  EXPECT_EQ (2, slot.getNumDelivered ());
+  EXPECT_EQ (99, slot.getNumSkipped ());
+}
+
+static void
+openGateLater (Recorder* recorder)
+{
+  boost::this_thread::sleep (boost::posix_time::milliseconds (10));
+  recorder->openGate ();
+}
+
+TEST (AsyncSlotTest, StopDiscardsPendingItem)
+{
+  Recorder recorder (false);
+  AsyncSlot<int> slot (boost::bind (&Recorder::callback, &recorder, _1));
+  slot.post (0);
+  recorder.waitForItems (1);
+  slot.post (1);
+  boost::thread opener (boost::bind (&openGateLater, &recorder));
+  // Waits for the running callback to return
+  slot.stop ();
+  opener.join ();
+  slot.post (2);
+  ASSERT_EQ (1, recorder.items.size ());
+  EXPECT_EQ (1, slot.getNumDelivered ());
+  EXPECT_EQ (2, slot.getNumSkipped ());
+}
+
+TEST (AsyncSlotTest, ReleasesItems)
+{
+  boost::shared_ptr<int> item (new int (0));
+  {
+    Recorder recorder;
+    AsyncSlot<boost::shared_ptr<int> > slot (boost::bind (&Recorder::callback, &recorder, boost::bind (&boost::shared_ptr<int>::operator*, _1)));
+    slot.post (item);
+    recorder.waitForItems (1);
+    slot.stop ();
+    EXPECT_TRUE (item.unique ());
+  }
+  EXPECT_TRUE (item.unique ());
+}
+
+int main (int argc, char **argv)
+{
+  testing::InitGoogleTest (&argc, argv);
+  return RUN_ALL_TESTS ();
+}
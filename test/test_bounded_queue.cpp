@@ -0,0 +1,147 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "bounded_queue.h"
+
+using namespace pcl::io;
+
+TEST (BoundedQueueTest, FirstInFirstOut)
+{
+  BoundedQueue<int> queue (4, BLOCK);
+  for (int i = 0; i < 4; ++i)
+    EXPECT_TRUE (queue.push (i));
+  EXPECT_EQ (4, queue.size ());
+  int item;
+  for (int i = 0; i < 4; ++i)
+  {
+    ASSERT_TRUE (queue.pop (item));
+    EXPECT_EQ (i, item);
+  }
+  EXPECT_EQ (0, queue.size ());
+  EXPECT_EQ (4, queue.getNumPushed ());
+  EXPECT_EQ (0, queue.getNumDropped ());
+}
+
+TEST (BoundedQueueTest, DropOldest)
+{
+  BoundedQueue<int> queue (2, DROP_OLDEST);
+  for (int i = 0; i < 5; ++i)
+    EXPECT_TRUE (queue.push (i));
+  EXPECT_EQ (5, queue.getNumPushed ());
+  EXPECT_EQ (3, queue.getNumDropped ());
+  int item;
+  ASSERT_TRUE (queue.pop (item));
+  EXPECT_EQ (3, item);
+  ASSERT_TRUE (queue.pop (item));
+  EXPECT_EQ (4, item);
+}
+
+TEST (BoundedQueueTest, DropNewest)
+{
+  BoundedQueue<int> queue (2, DROP_NEWEST);
+  EXPECT_TRUE (queue.push (0));
+  EXPECT_TRUE (queue.push (1));
+  EXPECT_FALSE (queue.push (2));
+  EXPECT_FALSE (queue.push (3));
+  EXPECT_EQ (2, queue.getNumDropped ());
+  int item;
+  ASSERT_TRUE (queue.pop (item));
+  EXPECT_EQ (0, item);
+  ASSERT_TRUE (queue.pop (item));
+  EXPECT_EQ (1, item);
+}
+
+static void
+produce (BoundedQueue<int>* queue, int num_items)
+{
+  for (int i = 0; i < num_items; ++i)
+    queue->push (i);
+}
+
+TEST (BoundedQueueTest, BlockDoesNotLoseItems)
+{
+  BoundedQueue<int> queue (3, BLOCK);
+  boost::thread producer (boost::bind (&produce, &queue, 1000));
+  int item;
+  for (int i = 0; i < 1000; ++i)
+  {
+    ASSERT_TRUE (queue.pop (item));
+    EXPECT_EQ (i, item);
+  }
+  producer.join ();
+  EXPECT_EQ (0, queue.getNumDropped ());
+}
+
+static void
+consume (BoundedQueue<int>* queue, bool* result)
+{
+  int item;
+  *result = queue->pop (item);
+}
+
+TEST (BoundedQueueTest, CloseWakesUpWaitingThreads)
+{
+  BoundedQueue<int> empty_queue (2, BLOCK);
+  bool popped = true;
+  boost::thread consumer (boost::bind (&consume, &empty_queue, &popped));
+  boost::this_thread::sleep (boost::posix_time::milliseconds (10));
+  empty_queue.close ();
+  consumer.join ();
+  EXPECT_FALSE (popped);
+
+  BoundedQueue<int> full_queue (2, BLOCK);
+  full_queue.push (0);
+  full_queue.push (1);
+  boost::thread producer (boost::bind (&produce, &full_queue, 1));
+  boost::this_thread::sleep (boost::posix_time::milliseconds (10));
+  full_queue.close ();
+  producer.join ();
+  EXPECT_EQ (0, full_queue.size ());
+  EXPECT_EQ (2, full_queue.getCapacity ());
+  EXPECT_FALSE (full_queue.push (2));
+}
+
+int main (int argc, char **argv)
+{
+  testing::InitGoogleTest (&argc, argv);
+  return RUN_ALL_TESTS ();
+}
@@ -38,11 +38,49 @@
 #include <gtest/gtest.h>
 
 #include <cmath>
+#include <cstdlib>
+#include <new>
+#include <algorithm>
 
 #include "buffers.h"
 
 using namespace pcl::io;
 
+/* Global allocation counter, used to check that pushing into buffers does
+ * not allocate memory. */
+static size_t num_allocations = 0;
+
+/* The replacements must not be inlined, otherwise GCC sees malloc () paired
+ * with operator delete (or operator new with free ()) and warns about the
+ * mismatch. */
+#if defined (__GNUC__)
+#define NOINLINE __attribute__ ((noinline))
+#elif defined (_MSC_VER)
+#define NOINLINE __declspec (noinline)
+#else
+#define NOINLINE
+#endif
+
+NOINLINE void* operator new (size_t size)
+{
+  ++num_allocations;
+  void* ptr = malloc (size);
+  if (!ptr)
+    throw std::bad_alloc ();
+  return (ptr);
+}
+
+NOINLINE void operator delete (void* ptr) throw ()
+{
+  free (ptr);
+}
+
+/* Compilers with sized deallocation call this one instead. */
+NOINLINE void operator delete (void* ptr, size_t) throw ()
+{
+  free (ptr);
+}
+
 template <typename T>
 class BuffersTest : public ::testing::Test
 {
@@ -67,11 +105,19 @@ class BuffersTest : public ::testing::Test
         std::vector<T> d (buffer.size ());
         memcpy (d.data (), dptr, buffer.size () * sizeof (T));
         buffer.push (d);
+        std::vector<T> r (buffer.size ());
+        buffer.copyTo (r.data ());
         for (size_t j = 0; j < buffer.size (); ++j)
           if (isnan (eptr[j]))
+          {
             EXPECT_TRUE (isnan (buffer[j]));
+            EXPECT_TRUE (isnan (r[j]));
+          }
           else
+          {
             EXPECT_EQ (eptr[j], buffer[j]);
+            EXPECT_EQ (eptr[j], r[j]);
+          }
         dptr += buffer.size ();
         eptr += buffer.size ();
       }
@@ -177,6 +223,259 @@ TYPED_TEST (BuffersTest, MedianBufferSize3Window3)
   }
 }
 
+/* Straightforward median computation used as a reference for MedianBuffer.
+ * Keeps full history of pushed data and sorts the last window_size samples of
+ * each element, treating invalid values as larger than everything else. */
+template <typename T>
+class ReferenceMedian
+{
+
+  public:
+
+    ReferenceMedian (size_t size, size_t window_size)
+    : size_ (size)
+    , window_size_ (window_size)
+    , history_ (window_size, std::vector<T> (size, invalid ()))
+    {
+    }
+
+    void
+    push (const std::vector<T>& data)
+    {
+      history_.push_back (data);
+    }
+
+    T
+    operator[] (size_t idx) const
+    {
+      std::vector<T> window;
+      size_t invalid_count = 0;
+      for (size_t i = history_.size () - window_size_; i < history_.size (); ++i)
+      {
+        if (isInvalid (history_[i][idx]))
+          ++invalid_count;
+        else
+          window.push_back (history_[i][idx]);
+      }
+      if (invalid_count == window_size_)
+        return (invalid ());
+      std::sort (window.begin (), window.end ());
+      return (window[(window_size_ - invalid_count) / 2]);
+    }
+
+  private:
+
+    static T invalid ()
+    {
+      return (std::numeric_limits<T>::has_quiet_NaN ? std::numeric_limits<T>::quiet_NaN () : 0);
+    }
+
+    static bool isInvalid (T value)
+    {
+      return (std::numeric_limits<T>::has_quiet_NaN ? isnan (value) : value == 0);
+    }
+
+    size_t size_;
+    size_t window_size_;
+    std::vector<std::vector<T> > history_;
+
+};
+
+TYPED_TEST (BuffersTest, MedianBufferMatchesReference)
+{
+  const size_t size = 97;
+  const size_t num_pushes = 50;
+  srand (42);
+  for (size_t window_size = 1; window_size <= 9; ++window_size)
+  {
+    MedianBuffer<TypeParam> mb (size, window_size);
+    ReferenceMedian<TypeParam> ref (size, window_size);
+    for (size_t n = 0; n < num_pushes; ++n)
+    {
+      std::vector<TypeParam> d (size);
+      for (size_t i = 0; i < size; ++i)
+        d[i] = rand () % 5 == 0 ? this->invalid_ : static_cast<TypeParam> (rand () % 16 - 8);
+      ref.push (d);
+      mb.push (d);
+      for (size_t i = 0; i < size; ++i)
+        if (isnan (ref[i]))
+          EXPECT_TRUE (isnan (mb[i]));
+        else
+          EXPECT_EQ (ref[i], mb[i]) << "window " << window_size << ", push " << n << ", element " << i;
+    }
+  }
+}
+
+template <typename T, size_t N> void
+checkFixedMedianBuffer (T invalid)
+{
+  const size_t size = 97;
+  FixedMedianBuffer<T, N> fmb (size);
+  ReferenceMedian<T> ref (size, N);
+  for (size_t n = 0; n < 30; ++n)
+  {
+    std::vector<T> d (size);
+    for (size_t i = 0; i < size; ++i)
+      d[i] = rand () % 5 == 0 ? invalid : static_cast<T> (rand () % 16 - 8);
+    ref.push (d);
+    fmb.push (d);
+    std::vector<T> r (size);
+    fmb.copyTo (r.data ());
+    for (size_t i = 0; i < size; ++i)
+      if (isnan (ref[i]))
+      {
+        EXPECT_TRUE (isnan (fmb[i]));
+        EXPECT_TRUE (isnan (r[i]));
+      }
+      else
+      {
+        EXPECT_EQ (ref[i], fmb[i]) << "window " << N << ", push " << n << ", element " << i;
+        EXPECT_EQ (ref[i], r[i]) << "window " << N << ", push " << n << ", element " << i;
+      }
+  }
+}
+
+TYPED_TEST (BuffersTest, FixedMedianBufferMatchesReference)
+{
+  srand (42);
+  checkFixedMedianBuffer<TypeParam, 1> (this->invalid_);
+  checkFixedMedianBuffer<TypeParam, 2> (this->invalid_);
+  checkFixedMedianBuffer<TypeParam, 3> (this->invalid_);
+  checkFixedMedianBuffer<TypeParam, 4> (this->invalid_);
+  checkFixedMedianBuffer<TypeParam, 5> (this->invalid_);
+  checkFixedMedianBuffer<TypeParam, 7> (this->invalid_);
+}
+
+TYPED_TEST (BuffersTest, ExponentialBufferAlpha1)
+{
+  ExponentialBuffer<TypeParam> eb (1, 1.0f);
+  const TypeParam data[] = {5, 4, 3, 2, 1};
+  this->checkBuffer (eb, data, data, sizeof (data) / sizeof (TypeParam));
+}
+
+TYPED_TEST (BuffersTest, ExponentialBufferAlpha05)
+{
+  const TypeParam& invalid = this->invalid_;
+  ExponentialBuffer<TypeParam> eb (1, 0.5f, 2);
+  const TypeParam data[] = {4, 8, invalid, 2, invalid, invalid, 10, 6};
+  const TypeParam filtered[] = {4, 6, 6, 4, 4, invalid, 10, 8};
+  this->checkBuffer (eb, data, filtered, sizeof (data) / sizeof (TypeParam));
+}
+
+TYPED_TEST (BuffersTest, ExponentialBufferPushInvalid)
+{
+  const TypeParam& invalid = this->invalid_;
+  ExponentialBuffer<TypeParam> eb (1, 0.5f);
+  const TypeParam data[] = {invalid, 4, invalid, 6, 2};
+  const TypeParam filtered[] = {invalid, 4, invalid, 6, 4};
+  this->checkBuffer (eb, data, filtered, sizeof (data) / sizeof (TypeParam));
+}
+
+TYPED_TEST (BuffersTest, AdaptiveBufferRestart)
+{
+  const TypeParam& invalid = this->invalid_;
+  AdaptiveBuffer<TypeParam> ab (1, 3, 3);
+  const TypeParam data[] = {4, 6, 8, 30, 32, invalid, 34, invalid, invalid, invalid, 10};
+  const TypeParam filtered[] = {4, 5, 6, 30, 31, 31, 32, 32, 32, invalid, 10};
+  this->checkBuffer (ab, data, filtered, sizeof (data) / sizeof (TypeParam));
+}
+
+TYPED_TEST (BuffersTest, AdaptiveBufferSaturation)
+{
+  AdaptiveBuffer<TypeParam> ab (1, 2, 10);
+  const TypeParam data[] = {2, 4, 7, 9};
+  const TypeParam filtered[] = {2, 3, 5, 7};
+  this->checkBuffer (ab, data, filtered, sizeof (data) / sizeof (TypeParam));
+}
+
+TYPED_TEST (BuffersTest, ReadRange)
+{
+  const size_t size = 20;
+  SingleBuffer<TypeParam> sb (size);
+  MedianBuffer<TypeParam> mb (size, 3);
+  AverageBuffer<TypeParam> ab (size, 3);
+  Buffer<TypeParam>* buffers[] = {&sb, &mb, &ab};
+  for (size_t n = 0; n < 4; ++n)
+  {
+    std::vector<TypeParam> d (size);
+    for (size_t i = 0; i < size; ++i)
+      d[i] = (i + n) % 7 == 0 ? this->invalid_ : static_cast<TypeParam> (i + n);
+    for (size_t b = 0; b < 3; ++b)
+    {
+      std::vector<TypeParam> copy (d);
+      buffers[b]->push (copy);
+      std::vector<TypeParam> r (size);
+      buffers[b]->read (r.data (), 5, 12);
+      for (size_t i = 5; i < 12; ++i)
+        if (isnan ((*buffers[b])[i]))
+          EXPECT_TRUE (isnan (r[i - 5]));
+        else
+          EXPECT_EQ ((*buffers[b])[i], r[i - 5]);
+    }
+  }
+}
+
+TYPED_TEST (BuffersTest, PushPointerDoesNotAllocate)
+{
+  const size_t size = 640;
+  SingleBuffer<TypeParam> sb (size);
+  MedianBuffer<TypeParam> mb (size, 5);
+  AverageBuffer<TypeParam> ab (size, 5);
+  Buffer<TypeParam>* buffers[] = {&sb, &mb, &ab};
+  std::vector<TypeParam> d (size);
+  std::vector<TypeParam> r (size);
+  for (size_t b = 0; b < 3; ++b)
+  {
+    size_t num_allocations_before = num_allocations;
+    for (size_t n = 0; n < 100; ++n)
+    {
+      for (size_t i = 0; i < size; ++i)
+        d[i] = (i * 7 + n) % 11 == 0 ? this->invalid_ : static_cast<TypeParam> ((i + n) % 13);
+      buffers[b]->push (d.data ());
+      buffers[b]->copyTo (r.data ());
+    }
+    EXPECT_EQ (num_allocations_before, num_allocations);
+  }
+}
+
+TYPED_TEST (BuffersTest, ParallelMatchesSerial)
+{
+  const size_t size = 1000;
+  ThreadPool::Ptr pool (new ThreadPool (4));
+  MedianBuffer<TypeParam> mb (size, 5);
+  MedianBuffer<TypeParam> mb_parallel (size, 5);
+  mb_parallel.setThreadPool (pool, 64);
+  FixedMedianBuffer<TypeParam, 5> fmb (size);
+  FixedMedianBuffer<TypeParam, 5> fmb_parallel (size);
+  fmb_parallel.setThreadPool (pool, 64);
+  AverageBuffer<TypeParam> ab (size, 5);
+  AverageBuffer<TypeParam> ab_parallel (size, 5);
+  ab_parallel.setNumThreads (3);
+  Buffer<TypeParam>* buffers[] = {&mb, &fmb, &ab};
+  Buffer<TypeParam>* parallel_buffers[] = {&mb_parallel, &fmb_parallel, &ab_parallel};
+  srand (42);
+  for (size_t n = 0; n < 20; ++n)
+  {
+    std::vector<TypeParam> d (size);
+    for (size_t i = 0; i < size; ++i)
+      d[i] = rand () % 5 == 0 ? this->invalid_ : static_cast<TypeParam> (rand () % 16 - 8);
+    for (size_t b = 0; b < 3; ++b)
+    {
+      buffers[b]->push (d.data ());
+      parallel_buffers[b]->push (d.data ());
+      std::vector<TypeParam> r (size);
+      std::vector<TypeParam> r_parallel (size);
+      buffers[b]->copyTo (r.data ());
+      parallel_buffers[b]->copyTo (r_parallel.data ());
+      for (size_t i = 0; i < size; ++i)
+        if (isnan (r[i]))
+          EXPECT_TRUE (isnan (r_parallel[i]));
+        else
+          EXPECT_EQ (r[i], r_parallel[i]);
+    }
+  }
+}
+
 TYPED_TEST (BuffersTest, AverageBufferWindow1)
 {
   AverageBuffer<TypeParam> ab (1, 1);
@@ -225,6 +524,148 @@ TYPED_TEST (BuffersTest, AverageBufferPushInvalid)
   this->checkBuffer (ab, data, median, sizeof (data) / sizeof (TypeParam));
 }
 
+TEST (AverageBufferDepthTest, NoOverflow)
+{
+  AverageBuffer<unsigned short> ab (1, 8);
+  for (size_t i = 0; i < 8; ++i)
+  {
+    std::vector<unsigned short> d (1, 60000);
+    ab.push (d);
+    EXPECT_EQ (60000, ab[0]);
+  }
+}
+
+TEST (AverageBufferDepthTest, KernelsMatchScalar)
+{
+  typedef accumulator_traits<unsigned short>::type AccumulatorT;
+  const size_t size = 1003;
+  const size_t windows[] = {1, 2, 8, 255};
+  srand (42);
+  for (size_t w = 0; w < sizeof (windows) / sizeof (size_t); ++w)
+  {
+    const size_t window_size = windows[w];
+    std::vector<unsigned short> data (window_size * size, 0);
+    std::vector<AccumulatorT> sum (size, 0);
+    std::vector<AccumulatorT> sum_ref (size, 0);
+    std::vector<unsigned char> count (size, window_size);
+    std::vector<unsigned char> count_ref (size, window_size);
+    std::vector<unsigned short> out (size);
+    std::vector<unsigned short> out_ref (size);
+    for (size_t n = 0; n < 2 * window_size + 10; ++n)
+    {
+      std::vector<unsigned short> d (size);
+      for (size_t i = 0; i < size; ++i)
+        d[i] = rand () % 4 == 0 ? 0 : (rand () % 2 ? 65535 - rand () % 16 : rand () % 65536);
+      unsigned short* old = &data[(n % window_size) * size];
+      // Process a misaligned subrange with the kernel to exercise the tails
+      detail::averagePush (d.data (), old, sum.data (), count.data (), 0, 3);
+      detail::averagePush (d.data (), old, sum.data (), count.data (), 3, size);
+      detail::averagePushScalar (d.data (), old, sum_ref.data (), count_ref.data (), 0, size);
+      std::copy (d.begin (), d.end (), old);
+      ASSERT_TRUE (sum == sum_ref);
+      ASSERT_TRUE (count == count_ref);
+      detail::averageRead (sum.data (), count.data (), window_size, out.data (), 1, size);
+      detail::averageReadScalar (sum.data (), count.data (), window_size, out_ref.data (), 1, size);
+      ASSERT_TRUE (out == out_ref);
+    }
+  }
+}
+
+template <size_t N> void
+checkFixedMedianKernel ()
+{
+  const size_t size = 1003;
+  srand (42);
+  std::vector<unsigned short> data (N * size);
+  for (size_t i = 0; i < data.size (); ++i)
+    data[i] = rand () % 4 == 0 ? 0 : (rand () % 2 ? 65535 - rand () % 4 : rand () % 8);
+  // Make sure that some elements have all values invalid
+  for (size_t k = 0; k < N; ++k)
+    data[k * size + 10] = 0;
+  std::vector<unsigned short> out (size);
+  std::vector<unsigned short> out_ref (size);
+  detail::fixedMedianRead<N> (data.data (), size, out.data (), 1, size);
+  detail::fixedMedianReadScalar<N> (data.data (), size, out_ref.data (), 1, size);
+  EXPECT_TRUE (out == out_ref) << "window " << N;
+}
+
+TEST (FixedMedianBufferDepthTest, KernelsMatchScalar)
+{
+  checkFixedMedianKernel<1> ();
+  checkFixedMedianKernel<2> ();
+  checkFixedMedianKernel<3> ();
+  checkFixedMedianKernel<5> ();
+  checkFixedMedianKernel<7> ();
+  checkFixedMedianKernel<9> ();
+}
+
+TEST (FixedMedianBufferDepthTest, MatchesMedianBuffer)
+{
+  const size_t size = 640;
+  MedianBuffer<unsigned short> mb (size, 5);
+  FixedMedianBuffer<unsigned short, 5> fmb (size);
+  std::vector<unsigned short> r (size);
+  std::vector<unsigned short> r_ref (size);
+  srand (42);
+  for (size_t n = 0; n < 20; ++n)
+  {
+    std::vector<unsigned short> d (size);
+    for (size_t i = 0; i < size; ++i)
+      d[i] = rand () % 5 == 0 ? 0 : 500 + rand () % 100;
+    mb.push (d.data ());
+    fmb.push (d.data ());
+    mb.copyTo (r_ref.data ());
+    fmb.copyTo (r.data ());
+    EXPECT_TRUE (r == r_ref);
+  }
+}
+
+TEST (HistogramMedianBufferTest, MatchesReference)
+{
+  const size_t size = 50;
+  const size_t windows[] = {1, 2, 5, 33, 300};
+  const unsigned int quantization_bits[] = {0, 2};
+  srand (42);
+  for (size_t w = 0; w < sizeof (windows) / sizeof (size_t); ++w)
+  {
+    for (size_t q = 0; q < 2; ++q)
+    {
+      const size_t window_size = windows[w];
+      const unsigned short quantization = 1 << quantization_bits[q];
+      HistogramMedianBuffer hmb (size, window_size, quantization_bits[q]);
+      ReferenceMedian<unsigned short> ref (size, window_size);
+      for (size_t n = 0; n < window_size + 40; ++n)
+      {
+        std::vector<unsigned short> d (size);
+        for (size_t i = 0; i < size; ++i)
+        {
+          // Elements are noisy measurements of a static surface, flip
+          // between two surfaces (as on object edges), or jump between
+          // random values so that the median changes coarse bins
+          if (rand () % 5 == 0)
+            d[i] = 0;
+          else if (i % 3 == 0)
+            d[i] = 1000 + i + rand () % 20;
+          else if (i % 3 == 1)
+            d[i] = (rand () % 2 ? 1000 : 5000) + rand () % 300;
+          else
+            d[i] = rand () % 65535 + 1;
+        }
+        ref.push (d);
+        hmb.push (d.data ());
+        std::vector<unsigned short> r (size);
+        hmb.copyTo (r.data ());
+        for (size_t i = 0; i < size; ++i)
+        {
+          unsigned short expected = ref[i] / quantization * quantization;
+          ASSERT_EQ (expected, hmb[i]) << "window " << window_size << ", quantization " << quantization << ", push " << n << ", element " << i;
+          ASSERT_EQ (expected, r[i]);
+        }
+      }
+    }
+  }
+}
+
 int main (int argc, char **argv)
 {
   testing::InitGoogleTest (&argc, argv);
@@ -0,0 +1,231 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+
+#include "real_sense/decimation.h"
+
+using namespace pcl::io::real_sense;
+
+/* 4x4 image made of 2x2 blocks:
+ *
+ *   10 20 | 0  0
+ *   30 40 | 0  7
+ *   ------+------
+ *    5  0 | 1  2
+ *    0  0 | 3  9
+ */
+static const boost::uint16_t IMAGE[] = { 10, 20,  0,  0,
+                                         30, 40,  0,  7,
+                                          5,  0,  1,  2,
+                                          0,  0,  3,  9 };
+
+TEST (DecimationTest, Stride)
+{
+  std::vector<boost::uint16_t> output (4);
+  decimateDepth (IMAGE, 4, 4, 2, DECIMATION_STRIDE, output.data ());
+  EXPECT_EQ (10, output[0]);
+  EXPECT_EQ (0, output[1]);
+  EXPECT_EQ (5, output[2]);
+  EXPECT_EQ (1, output[3]);
+}
+
+TEST (DecimationTest, MeanIgnoresInvalidPixels)
+{
+  std::vector<boost::uint16_t> output (4);
+  decimateDepth (IMAGE, 4, 4, 2, DECIMATION_MEAN, output.data ());
+  EXPECT_EQ (25, output[0]);
+  EXPECT_EQ (7, output[1]);
+  EXPECT_EQ (5, output[2]);
+  EXPECT_EQ (4, output[3]);
+
+  std::vector<boost::uint16_t> empty (16, 0);
+  decimateDepth (empty.data (), 4, 4, 4, DECIMATION_MEAN, output.data ());
+  EXPECT_EQ (0, output[0]);
+}
+
+TEST (DecimationTest, MedianIgnoresInvalidPixels)
+{
+  std::vector<boost::uint16_t> output (4);
+  decimateDepth (IMAGE, 4, 4, 2, DECIMATION_MEDIAN, output.data ());
+  EXPECT_EQ (20, output[0]);
+  EXPECT_EQ (7, output[1]);
+  EXPECT_EQ (5, output[2]);
+  EXPECT_EQ (2, output[3]);
+
+  decimateDepth (IMAGE, 4, 4, 4, DECIMATION_MEDIAN, output.data ());
+  // Valid values are 1 2 3 5 7 9 10 20 30 40, lower median is 7
+  EXPECT_EQ (7, output[0]);
+}
+
+/* Straightforward binning of a single block for reference. */
+static boost::uint16_t
+binBlock (const std::vector<boost::uint16_t>& image, unsigned int width,
+          unsigned int u, unsigned int v, unsigned int factor, DecimationMethod method)
+{
+  std::vector<boost::uint16_t> valid;
+  for (unsigned int j = 0; j < factor; ++j)
+    for (unsigned int i = 0; i < factor; ++i)
+      if (image[(v * factor + j) * width + u * factor + i])
+        valid.push_back (image[(v * factor + j) * width + u * factor + i]);
+  if (valid.empty ())
+    return (0);
+  std::sort (valid.begin (), valid.end ());
+  if (method == DECIMATION_MEDIAN)
+    return (valid[(valid.size () - 1) / 2]);
+  unsigned int sum = 0;
+  for (size_t i = 0; i < valid.size (); ++i)
+    sum += valid[i];
+  return ((sum + valid.size () / 2) / valid.size ());
+}
+
+TEST (DecimationTest, BinningMatchesReference)
+{
+  // Width is not a multiple of the chunk size used by the implementation
+  const unsigned int width = 650;
+  const unsigned int height = 37;
+  std::vector<boost::uint16_t> image (width * height);
+  srand (1);
+  for (size_t i = 0; i < image.size (); ++i)
+    image[i] = rand () % 4 == 0 ? 0 : rand () % 65535 + 1;
+  for (unsigned int factor = 2; factor <= MAX_BINNING_DECIMATION_FACTOR; ++factor)
+    for (int m = DECIMATION_MEDIAN; m <= DECIMATION_MEAN; ++m)
+    {
+      const DecimationMethod method = static_cast<DecimationMethod> (m);
+      const unsigned int out_width = width / factor;
+      const unsigned int out_height = height / factor;
+      std::vector<boost::uint16_t> output (out_width * out_height);
+      decimateDepth (image.data (), width, height, factor, method, output.data ());
+      for (unsigned int v = 0; v < out_height; ++v)
+        for (unsigned int u = 0; u < out_width; ++u)
+          ASSERT_EQ (binBlock (image, width, u, v, factor, method), output[v * out_width + u])
+            << "factor " << factor << ", method " << m << ", block (" << u << ", " << v << ")";
+    }
+}
+
+TEST (DecimationTest, Region)
+{
+  // Decimating a region of an image in place should be the same as
+  // decimating a copy of it
+  const unsigned int width = 40, height = 30;
+  const unsigned int x = 5, y = 3, region_width = 22, region_height = 17;
+  std::vector<boost::uint16_t> image (width * height);
+  srand (2);
+  for (size_t i = 0; i < image.size (); ++i)
+    image[i] = rand () % 4 == 0 ? 0 : rand () % 5000;
+  std::vector<boost::uint16_t> region (region_width * region_height);
+  for (unsigned int v = 0; v < region_height; ++v)
+    for (unsigned int u = 0; u < region_width; ++u)
+      region[v * region_width + u] = image[(y + v) * width + x + u];
+  for (unsigned int factor = 1; factor <= 4; ++factor)
+    for (int m = DECIMATION_STRIDE; m <= DECIMATION_MEAN; ++m)
+    {
+      const DecimationMethod method = static_cast<DecimationMethod> (m);
+      const size_t size = (region_width / factor) * (region_height / factor);
+      std::vector<boost::uint16_t> expected (size);
+      std::vector<boost::uint16_t> output (size);
+      decimateDepth (region.data (), region_width, region_height, factor, method, expected.data ());
+      decimateDepth (image.data () + y * width + x, region_width, region_height, factor, method, output.data (), width);
+      EXPECT_EQ (expected, output) << "factor " << factor << ", method " << m;
+    }
+}
+
+TEST (DecimationTest, PartialBlocksAreDropped)
+{
+  std::vector<boost::uint16_t> input (7 * 5);
+  for (size_t i = 0; i < input.size (); ++i)
+    input[i] = i + 1;
+  std::vector<boost::uint16_t> output (3 * 2);
+  decimateDepth (input.data (), 7, 5, 2, DECIMATION_STRIDE, output.data ());
+  EXPECT_EQ (1, output[0]);
+  EXPECT_EQ (3, output[1]);
+  EXPECT_EQ (5, output[2]);
+  EXPECT_EQ (15, output[3]);
+  EXPECT_EQ (17, output[4]);
+  EXPECT_EQ (19, output[5]);
+}
+
+TEST (DecimationTest, SubsampleWithOffset)
+{
+  std::vector<boost::uint32_t> input (16);
+  for (size_t i = 0; i < input.size (); ++i)
+    input[i] = i;
+  std::vector<boost::uint32_t> output (4);
+  subsample (input.data (), 4, 4, 2, getDecimationOffset (2, DECIMATION_MEAN), output.data ());
+  EXPECT_EQ (5, output[0]);
+  EXPECT_EQ (7, output[1]);
+  EXPECT_EQ (13, output[2]);
+  EXPECT_EQ (15, output[3]);
+}
+
+TEST (DecimationTest, DecimatedRaysPointAtBlockCenters)
+{
+  // A ray of a decimated table should match the average of the rays of the
+  // pixels in the block (exactly, for a pinhole camera)
+  const CameraIntrinsics intrinsics (475.0f, 470.0f, 310.5f, 245.5f);
+  RayTable full (640, 480, intrinsics);
+  for (unsigned int factor = 2; factor <= 4; factor *= 2)
+  {
+    RayTable binned (640 / factor, 480 / factor, decimateIntrinsics (intrinsics, factor, DECIMATION_MEAN));
+    RayTable strided (640 / factor, 480 / factor, decimateIntrinsics (intrinsics, factor, DECIMATION_STRIDE));
+    for (unsigned int v = 0; v < 480 / factor; v += 7)
+      for (unsigned int u = 0; u < 640 / factor; u += 7)
+      {
+        float x = 0.0f, y = 0.0f;
+        for (unsigned int j = 0; j < factor; ++j)
+          for (unsigned int i = 0; i < factor; ++i)
+          {
+            x += full.getRay (u * factor + i, v * factor + j)[0];
+            y += full.getRay (u * factor + i, v * factor + j)[1];
+          }
+        EXPECT_NEAR (x / (factor * factor), binned.getRay (u, v)[0], 1e-5);
+        EXPECT_NEAR (y / (factor * factor), binned.getRay (u, v)[1], 1e-5);
+        EXPECT_NEAR (full.getRay (u * factor, v * factor)[0], strided.getRay (u, v)[0], 1e-5);
+        EXPECT_NEAR (full.getRay (u * factor, v * factor)[1], strided.getRay (u, v)[1], 1e-5);
+      }
+  }
+}
+
+int main (int argc, char **argv)
+{
+  testing::InitGoogleTest (&argc, argv);
+  return RUN_ALL_TESTS ();
+}
@@ -0,0 +1,94 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <boost/weak_ptr.hpp>
+#include <boost/make_shared.hpp>
+
+#include "real_sense/image.h"
+
+using namespace pcl::io::real_sense;
+
+TEST (ImageTest, PaddedRows)
+{
+  // 3x2 image with rows padded to 4 pixels
+  boost::shared_ptr<std::vector<boost::uint16_t> > data = boost::make_shared<std::vector<boost::uint16_t> > (8, 0);
+  for (int v = 0; v < 2; ++v)
+    for (int u = 0; u < 3; ++u)
+      (*data)[v * 4 + u] = v * 10 + u;
+  DepthImage image (data->data (), 3, 2, 4 * sizeof (boost::uint16_t), 42, data);
+  EXPECT_EQ (3, image.getWidth ());
+  EXPECT_EQ (2, image.getHeight ());
+  EXPECT_EQ (8, image.getStride ());
+  EXPECT_EQ (42, image.getTimestamp ());
+  EXPECT_FALSE (image.isContiguous ());
+  EXPECT_EQ (data->data (), image.getData ());
+  EXPECT_EQ (data->data () + 4, image.getRow (1));
+  for (int v = 0; v < 2; ++v)
+    for (int u = 0; u < 3; ++u)
+      EXPECT_EQ (v * 10 + u, image.at (u, v));
+}
+
+TEST (ImageTest, Contiguous)
+{
+  boost::shared_ptr<std::vector<boost::uint32_t> > data = boost::make_shared<std::vector<boost::uint32_t> > (6, 0);
+  ColorImage image (data->data (), 3, 2, 3 * sizeof (boost::uint32_t), 0, data);
+  EXPECT_TRUE (image.isContiguous ());
+}
+
+TEST (ImageTest, HandleLivesWithImage)
+{
+  boost::shared_ptr<std::vector<boost::uint16_t> > data = boost::make_shared<std::vector<boost::uint16_t> > (4, 0);
+  boost::weak_ptr<std::vector<boost::uint16_t> > weak = data;
+  DepthImage::ConstPtr image (new DepthImage (data->data (), 2, 2, 4, 0, data));
+  data.reset ();
+  EXPECT_FALSE (weak.expired ());
+  DepthImage::ConstPtr copy = image;
+  image.reset ();
+  EXPECT_FALSE (weak.expired ());
+  copy.reset ();
+  EXPECT_TRUE (weak.expired ());
+}
+
+int main (int argc, char **argv)
+{
+  testing::InitGoogleTest (&argc, argv);
+  return RUN_ALL_TESTS ();
+}
@@ -0,0 +1,144 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <boost/bind.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "interval_recorder.h"
+
+using namespace pcl::io;
+
+TEST (IntervalRecorderTest, Empty)
+{
+  IntervalRecorder recorder (8);
+  EXPECT_EQ (0, recorder.getStatistics ().num_intervals);
+  // A single event does not make an interval
+  recorder.record (1000);
+  IntervalStatistics stats = recorder.getStatistics ();
+  EXPECT_EQ (0, stats.num_intervals);
+  EXPECT_EQ (0.0, stats.frequency);
+}
+
+TEST (IntervalRecorderTest, Statistics)
+{
+  IntervalRecorder recorder (8);
+  // Intervals alternate between 30 and 40 ms
+  boost::uint64_t time = 0;
+  for (int i = 0; i < 9; ++i)
+  {
+    recorder.record (time);
+    time += i % 2 ? 30000 : 40000;
+  }
+  IntervalStatistics stats = recorder.getStatistics ();
+  EXPECT_EQ (8, stats.num_intervals);
+  EXPECT_DOUBLE_EQ (35000.0, stats.mean);
+  EXPECT_DOUBLE_EQ (5000.0, stats.jitter);
+  EXPECT_EQ (30000, stats.min);
+  EXPECT_EQ (40000, stats.max);
+  EXPECT_NEAR (1.0e+6 / 35000.0, stats.frequency, 1e-9);
+  EXPECT_EQ (0, stats.num_missed);
+}
+
+TEST (IntervalRecorderTest, KeepsMostRecentIntervals)
+{
+  IntervalRecorder recorder (4);
+  boost::uint64_t time = 0;
+  for (int i = 0; i < 10; ++i)
+  {
+    recorder.record (time);
+    time += i < 5 ? 1000 : 10;
+  }
+  IntervalStatistics stats = recorder.getStatistics ();
+  EXPECT_EQ (4, stats.num_intervals);
+  EXPECT_EQ (10, stats.max);
+  recorder.reset ();
+  EXPECT_EQ (0, recorder.getStatistics ().num_intervals);
+}
+
+TEST (IntervalRecorderTest, MissedEvents)
+{
+  IntervalRecorder recorder (16);
+  recorder.reset (33333);
+  // Events at 30 Hz with the 3rd and 6-7th missing, and a late one that is
+  // within tolerance
+  const boost::uint64_t times[] = { 0, 33333, 100000, 133333, 233333, 273333 };
+  for (size_t i = 0; i < sizeof (times) / sizeof (times[0]); ++i)
+    recorder.record (times[i]);
+  EXPECT_EQ (3, recorder.getStatistics ().num_missed);
+  EXPECT_EQ (3, recorder.getNumMissed ());
+  recorder.reset ();
+  EXPECT_EQ (0, recorder.getNumMissed ());
+}
+
+/* Writer records constant intervals while readers poll. Readers must only
+ * ever see intervals that were actually recorded. */
+void
+poll (IntervalRecorder* recorder, boost::atomic<bool>* done, bool* consistent)
+{
+  while (!done->load ())
+  {
+    IntervalStatistics stats = recorder->getStatistics ();
+    if (stats.num_intervals > 0 && (stats.min != 100 || stats.max != 100))
+      *consistent = false;
+  }
+}
+
+TEST (IntervalRecorderTest, ConcurrentReaders)
+{
+  IntervalRecorder recorder (16);
+  boost::atomic<bool> done (false);
+  bool consistent[2] = { true, true };
+  boost::thread reader1 (boost::bind (&poll, &recorder, &done, &consistent[0]));
+  boost::thread reader2 (boost::bind (&poll, &recorder, &done, &consistent[1]));
+  for (boost::uint64_t i = 0; i < 200000; ++i)
+    recorder.record (i * 100);
+  done = true;
+  reader1.join ();
+  reader2.join ();
+  EXPECT_TRUE (consistent[0]);
+  EXPECT_TRUE (consistent[1]);
+  EXPECT_EQ (16, recorder.getStatistics ().num_intervals);
+}
+
+int main (int argc, char **argv)
+{
+  testing::InitGoogleTest (&argc, argv);
+  return RUN_ALL_TESTS ();
+}
@@ -0,0 +1,83 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include "latency_recorder.h"
+
+using namespace pcl::io;
+
+TEST (LatencyRecorderTest, Empty)
+{
+  LatencyRecorder recorder (10);
+  LatencyStatistics stats = recorder.getStatistics ();
+  EXPECT_EQ (0, stats.num_samples);
+  EXPECT_EQ (0, stats.p50);
+  EXPECT_EQ (0, stats.p99);
+}
+
+TEST (LatencyRecorderTest, Percentiles)
+{
+  LatencyRecorder recorder (100);
+  // Record 1..100 in scrambled order
+  for (int i = 0; i < 100; ++i)
+    recorder.record ((i * 37) % 100 + 1);
+  LatencyStatistics stats = recorder.getStatistics ();
+  EXPECT_EQ (100, stats.num_samples);
+  EXPECT_DOUBLE_EQ (50.5, stats.mean);
+  EXPECT_EQ (50, stats.p50);
+  EXPECT_EQ (99, stats.p99);
+  EXPECT_EQ (100, stats.max);
+}
+
+TEST (LatencyRecorderTest, KeepsMostRecentSamples)
+{
+  LatencyRecorder recorder (4);
+  for (int i = 0; i < 10; ++i)
+    recorder.record (i < 6 ? 1000 : 10);
+  LatencyStatistics stats = recorder.getStatistics ();
+  EXPECT_EQ (4, stats.num_samples);
+  EXPECT_EQ (10, stats.max);
+  recorder.reset ();
+  EXPECT_EQ (0, recorder.getStatistics ().num_samples);
+}
+
+int main (int argc, char **argv)
+{
+  testing::InitGoogleTest (&argc, argv);
+  return RUN_ALL_TESTS ();
+}
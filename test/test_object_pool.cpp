@@ -0,0 +1,199 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "object_pool.h"
+
+using namespace pcl::io;
+
+/* Object that keeps track of how many instances exist. Pools call the
+ * factory outside of their lock, so the counter is atomic. */
+struct Counted
+{
+  Counted (boost::atomic<int>* num_instances) : num_instances_ (num_instances), value (0) { ++*num_instances_; }
+  ~Counted () { --*num_instances_; }
+  boost::atomic<int>* num_instances_;
+  int value;
+};
+
+static Counted*
+createCounted (boost::atomic<int>* num_instances)
+{
+  return (new Counted (num_instances));
+}
+
+TEST (ObjectPoolTest, ReusesReleasedObjects)
+{
+  boost::atomic<int> num_instances (0);
+  ObjectPool<Counted> pool (boost::bind (&createCounted, &num_instances), 2);
+  Counted* address;
+  {
+    boost::shared_ptr<Counted> a = pool.acquire ();
+    a->value = 42;
+    address = a.get ();
+    EXPECT_EQ (1, pool.getNumAllocated ());
+    EXPECT_EQ (0, pool.getNumFree ());
+  }
+  EXPECT_EQ (1, num_instances.load ());
+  EXPECT_EQ (1, pool.getNumFree ());
+  boost::shared_ptr<Counted> b = pool.acquire ();
+  EXPECT_EQ (address, b.get ());
+  EXPECT_EQ (42, b->value);
+  EXPECT_EQ (1, num_instances.load ());
+}
+
+TEST (ObjectPoolTest, GrowsUpToMaxSize)
+{
+  boost::atomic<int> num_instances (0);
+  ObjectPool<Counted> pool (boost::bind (&createCounted, &num_instances), 2);
+  {
+    boost::shared_ptr<Counted> a = pool.acquire ();
+    boost::shared_ptr<Counted> b = pool.acquire ();
+    boost::shared_ptr<Counted> c = pool.acquire ();
+    EXPECT_EQ (3, num_instances.load ());
+    EXPECT_EQ (2, pool.getNumAllocated ());
+  }
+  // The object that did not fit into the pool is deleted
+  EXPECT_EQ (2, num_instances.load ());
+  EXPECT_EQ (2, pool.getNumFree ());
+  // Zero size disables pooling
+  pool.setMaxSize (0);
+  EXPECT_EQ (0, num_instances.load ());
+  {
+    boost::shared_ptr<Counted> a = pool.acquire ();
+    EXPECT_EQ (1, num_instances.load ());
+  }
+  EXPECT_EQ (0, num_instances.load ());
+  EXPECT_EQ (0, pool.getNumAllocated ());
+}
+
+TEST (ObjectPoolTest, ShrinkWhileInUse)
+{
+  boost::atomic<int> num_instances (0);
+  ObjectPool<Counted> pool (boost::bind (&createCounted, &num_instances), 3);
+  boost::shared_ptr<Counted> a = pool.acquire ();
+  boost::shared_ptr<Counted> b = pool.acquire ();
+  boost::shared_ptr<Counted> c = pool.acquire ();
+  pool.setMaxSize (1);
+  EXPECT_EQ (3, num_instances.load ());
+  a.reset ();
+  b.reset ();
+  EXPECT_EQ (1, num_instances.load ());
+  c.reset ();
+  EXPECT_EQ (1, num_instances.load ());
+  EXPECT_EQ (1, pool.getNumAllocated ());
+  EXPECT_EQ (1, pool.getNumFree ());
+}
+
+TEST (ObjectPoolTest, ObjectsOutlivePool)
+{
+  boost::atomic<int> num_instances (0);
+  boost::shared_ptr<Counted> a;
+  {
+    ObjectPool<Counted> pool (boost::bind (&createCounted, &num_instances), 2);
+    a = pool.acquire ();
+    pool.acquire ();
+    EXPECT_EQ (2, num_instances.load ());
+  }
+  // Free objects are deleted together with the pool
+  EXPECT_EQ (1, num_instances.load ());
+  a->value = 1;
+  a.reset ();
+  EXPECT_EQ (0, num_instances.load ());
+}
+
+static Counted*
+createOrThrow (boost::atomic<int>* num_instances, bool* fail)
+{
+  if (*fail)
+    throw std::runtime_error ("factory failed");
+  return (new Counted (num_instances));
+}
+
+TEST (ObjectPoolTest, FactoryThrows)
+{
+  boost::atomic<int> num_instances (0);
+  bool fail = true;
+  ObjectPool<Counted> pool (boost::bind (&createOrThrow, &num_instances, &fail), 1);
+  EXPECT_THROW (pool.acquire (), std::runtime_error);
+  // The slot reserved for the object that failed to be created is free
+  EXPECT_EQ (0, pool.getNumAllocated ());
+  fail = false;
+  boost::shared_ptr<Counted> a = pool.acquire ();
+  EXPECT_EQ (1, pool.getNumAllocated ());
+  a.reset ();
+  EXPECT_EQ (1, pool.getNumFree ());
+}
+
+static void
+acquireAndRelease (ObjectPool<Counted>* pool)
+{
+  for (size_t i = 0; i < 1000; ++i)
+  {
+    boost::shared_ptr<Counted> a = pool->acquire ();
+    boost::shared_ptr<Counted> b = pool->acquire ();
+    a->value = b->value = static_cast<int> (i);
+  }
+}
+
+TEST (ObjectPoolTest, ConcurrentAccess)
+{
+  boost::atomic<int> num_instances (0);
+  {
+    ObjectPool<Counted> pool (boost::bind (&createCounted, &num_instances), 4);
+    boost::thread_group threads;
+    for (size_t i = 0; i < 4; ++i)
+      threads.create_thread (boost::bind (&acquireAndRelease, &pool));
+    threads.join_all ();
+    EXPECT_LE (pool.getNumAllocated (), 4);
+    EXPECT_EQ (pool.getNumAllocated (), pool.getNumFree ());
+  }
+  EXPECT_EQ (0, num_instances.load ());
+}
+
+int main (int argc, char **argv)
+{
+  testing::InitGoogleTest (&argc, argv);
+  return RUN_ALL_TESTS ();
+}
@@ -0,0 +1,147 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include <boost/cstdint.hpp>
+
+#include "real_sense/point_conversion.h"
+
+using namespace pcl::io::real_sense;
+
+/* Stand-ins for PCL points with the same padded layout. */
+struct Point
+{
+  float data[4];
+};
+
+struct ColoredPoint
+{
+  float data[4];
+  boost::uint32_t rgba;
+  float padding[3];
+};
+
+/* Generate vertices that cover valid and invalid depth, negative zeros,
+ * extreme and denormal values. */
+static std::vector<float>
+generateVertices (size_t size)
+{
+  const float special[] = { 0.0f, -0.0f, 1.0f, -1.0f, 1e-40f, -1e-40f, 3e38f, -3e38f, 0.1f, 65535.0f };
+  std::vector<float> vertices (3 * size);
+  srand (7);
+  for (size_t i = 0; i < vertices.size (); ++i)
+  {
+    if (rand () % 4 == 0)
+      vertices[i] = special[rand () % 10];
+    else
+      vertices[i] = (rand () % 200000 - 100000) / 7.0f;
+  }
+  return (vertices);
+}
+
+template <typename PointT> static void
+checkKernel (ConversionKernel kernel)
+{
+  if (!isConversionKernelSupported (kernel))
+  {
+    std::cout << "Kernel " << kernel << " is not supported by this CPU, skipping" << std::endl;
+    return;
+  }
+  // All sizes up to a few vector widths, to exercise remainder handling
+  for (size_t size = 0; size < 40; ++size)
+  {
+    std::vector<float> vertices = generateVertices (size);
+    std::vector<PointT> expected (size);
+    std::vector<PointT> points (size);
+    convertVertices (vertices.data (), expected.data (), size, 0.001f, SCALAR_KERNEL);
+    convertVertices (vertices.data (), points.data (), size, 0.001f, kernel);
+    for (size_t i = 0; i < size; ++i)
+      ASSERT_EQ (0, memcmp (expected[i].data, points[i].data, sizeof (expected[i].data))) << "size " << size << ", point " << i;
+  }
+}
+
+TEST (PointConversionTest, ScalarKernel)
+{
+  const float vertices[] = { 1000.0f, -500.0f, 250.0f, 3.0f, 4.0f, 0.0f, 0.0f, 0.0f, -0.0f };
+  Point points[3];
+  convertVertices (vertices, points, 3, 0.001f, SCALAR_KERNEL);
+  EXPECT_EQ (1000.0f * 0.001f, points[0].data[0]);
+  EXPECT_EQ (-500.0f * 0.001f, points[0].data[1]);
+  EXPECT_EQ (250.0f * 0.001f, points[0].data[2]);
+  EXPECT_EQ (1.0f, points[0].data[3]);
+  for (size_t i = 1; i < 3; ++i)
+  {
+    EXPECT_TRUE (std::isnan (points[i].data[0]));
+    EXPECT_TRUE (std::isnan (points[i].data[1]));
+    EXPECT_TRUE (std::isnan (points[i].data[2]));
+    EXPECT_EQ (1.0f, points[i].data[3]);
+  }
+}
+
+TEST (PointConversionTest, SSE4KernelMatchesScalar)
+{
+  checkKernel<Point> (SSE4_KERNEL);
+  checkKernel<ColoredPoint> (SSE4_KERNEL);
+}
+
+TEST (PointConversionTest, AVX2KernelMatchesScalar)
+{
+  checkKernel<Point> (AVX2_KERNEL);
+  checkKernel<ColoredPoint> (AVX2_KERNEL);
+}
+
+TEST (PointConversionTest, ColorIsPreserved)
+{
+  std::vector<float> vertices = generateVertices (9);
+  std::vector<ColoredPoint> points (9);
+  for (size_t i = 0; i < points.size (); ++i)
+    points[i].rgba = 0xff000000 + i;
+  convertVertices (vertices.data (), points.data (), 9);
+  for (size_t i = 0; i < points.size (); ++i)
+    EXPECT_EQ (0xff000000 + i, points[i].rgba);
+}
+
+int main (int argc, char **argv)
+{
+  testing::InitGoogleTest (&argc, argv);
+  return RUN_ALL_TESTS ();
+}
@@ -0,0 +1,251 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdlib>
+
+#include "real_sense/ray_table.h"
+
+using namespace pcl::io::real_sense;
+
+/* Stand-ins for PCL points with the same padded layout. */
+struct Point
+{
+  float data[4];
+};
+
+struct ColoredPoint
+{
+  float data[4];
+  boost::uint32_t rgba;
+  float padding[3];
+};
+
+/* Intrinsics of the depth stream of a typical F200 camera. */
+static CameraIntrinsics
+createIntrinsics ()
+{
+  CameraIntrinsics intrinsics (475.0f, 475.0f, 310.5f, 245.5f);
+  intrinsics.radial_distortion[0] = -0.15f;
+  intrinsics.radial_distortion[1] = 0.08f;
+  intrinsics.radial_distortion[2] = -0.01f;
+  intrinsics.tangential_distortion[0] = 0.002f;
+  intrinsics.tangential_distortion[1] = -0.001f;
+  return (intrinsics);
+}
+
+TEST (RayTableTest, PinholeWithoutDistortion)
+{
+  CameraIntrinsics intrinsics (500.0f, 400.0f, 32.0f, 24.0f);
+  RayTable table (64, 48, intrinsics);
+  for (size_t v = 0; v < 48; ++v)
+    for (size_t u = 0; u < 64; ++u)
+    {
+      const float* ray = table.getRay (u, v);
+      EXPECT_FLOAT_EQ ((u - 32.0f) / 500.0f, ray[0]);
+      EXPECT_FLOAT_EQ ((v - 24.0f) / 400.0f, ray[1]);
+      EXPECT_EQ (1.0f, ray[2]);
+    }
+}
+
+TEST (RayTableTest, RaysReprojectToPixels)
+{
+  // Projecting a ray back through the camera model should land within a
+  // small fraction of a pixel of where it started
+  CameraIntrinsics intrinsics = createIntrinsics ();
+  RayTable table (640, 480, intrinsics);
+  double max_error = 0.0;
+  for (size_t v = 0; v < 480; ++v)
+    for (size_t u = 0; u < 640; ++u)
+    {
+      const float* ray = table.getRay (u, v);
+      double xd, yd;
+      RayTable::distort (intrinsics, ray[0], ray[1], xd, yd);
+      max_error = std::max (max_error, std::fabs (xd * intrinsics.fx + intrinsics.cx - u));
+      max_error = std::max (max_error, std::fabs (yd * intrinsics.fy + intrinsics.cy - v));
+    }
+  EXPECT_LT (max_error, 1e-3);
+}
+
+TEST (RayTableTest, ProjectMatchesCameraModel)
+{
+  // Generate depth images of random scenes and check that projected points
+  // are where the camera model puts them, this is what QueryVertices does
+  const size_t width = 640;
+  const size_t height = 480;
+  CameraIntrinsics intrinsics = createIntrinsics ();
+  RayTable table (width, height, intrinsics);
+  std::vector<unsigned short> depth (width * height);
+  std::vector<Point> points (width * height);
+  srand (1);
+  for (size_t i = 0; i < depth.size (); ++i)
+    depth[i] = rand () % 10 == 0 ? 0 : 200 + rand () % 3000;
+  table.project (depth.data (), points.data ());
+  for (size_t v = 0; v < height; ++v)
+    for (size_t u = 0; u < width; ++u)
+    {
+      const size_t i = v * width + u;
+      const Point& p = points[i];
+      EXPECT_EQ (1.0f, p.data[3]);
+      if (depth[i] == 0)
+      {
+        EXPECT_TRUE (std::isnan (p.data[0]));
+        EXPECT_TRUE (std::isnan (p.data[1]));
+        EXPECT_TRUE (std::isnan (p.data[2]));
+        continue;
+      }
+      ASSERT_FLOAT_EQ (depth[i] * 0.001f, p.data[2]);
+      double xd, yd;
+      RayTable::distort (intrinsics, p.data[0] / p.data[2], p.data[1] / p.data[2], xd, yd);
+      ASSERT_NEAR (u, xd * intrinsics.fx + intrinsics.cx, 1e-3);
+      ASSERT_NEAR (v, yd * intrinsics.fy + intrinsics.cy, 1e-3);
+    }
+}
+
+TEST (RayTableTest, ProjectOddSize)
+{
+  // Vectorized projection handles pixels in groups, make sure the tail is
+  // processed identically
+  CameraIntrinsics intrinsics = createIntrinsics ();
+  RayTable table (7, 3, intrinsics);
+  std::vector<unsigned short> depth (21);
+  std::vector<Point> points (21);
+  for (size_t i = 0; i < depth.size (); ++i)
+    depth[i] = i % 3 == 0 ? 0 : 100 * i;
+  table.project (depth.data (), points.data (), 0.5f);
+  for (size_t i = 0; i < depth.size (); ++i)
+  {
+    const float* ray = table.getRay (i % 7, i / 7);
+    if (depth[i] == 0)
+    {
+      EXPECT_TRUE (std::isnan (points[i].data[2]));
+    }
+    else
+    {
+      float z = depth[i] * 0.5f;
+      EXPECT_EQ (ray[0] * z, points[i].data[0]);
+      EXPECT_EQ (ray[1] * z, points[i].data[1]);
+      EXPECT_EQ (z, points[i].data[2]);
+    }
+    EXPECT_EQ (1.0f, points[i].data[3]);
+  }
+}
+
+TEST (RayTableTest, FusedProjectMatchesSeparate)
+{
+  const size_t width = 33;
+  const size_t height = 5;
+  const size_t size = width * height;
+  RayTable table (width, height, createIntrinsics ());
+  std::vector<unsigned short> depth (size);
+  std::vector<boost::uint32_t> color (size);
+  for (size_t i = 0; i < size; ++i)
+  {
+    depth[i] = i % 5 == 0 ? 0 : 300 + 7 * i;
+    color[i] = 0x01000000 * (i % 256) + i;
+  }
+  std::vector<Point> expected (size);
+  table.project (depth.data (), expected.data ());
+  // Output arrays are offset by one element to also exercise unaligned
+  // stores
+  for (size_t offset = 0; offset < 2; ++offset)
+  {
+    std::vector<Point> points (size + 1);
+    std::vector<ColoredPoint> colored_points (size + 1);
+    std::vector<ColoredPoint> colored_points_only (size + 1);
+    table.project (depth.data (), color.data (), points.data () + offset, colored_points.data () + offset);
+    table.project (depth.data (), color.data (), colored_points_only.data () + offset);
+    for (size_t i = 0; i < size; ++i)
+    {
+      const ColoredPoint& c1 = colored_points[i + offset];
+      const ColoredPoint& c2 = colored_points_only[i + offset];
+      EXPECT_EQ (color[i], c1.rgba);
+      EXPECT_EQ (color[i], c2.rgba);
+      for (size_t k = 0; k < 4; ++k)
+      {
+        if (std::isnan (expected[i].data[k]))
+        {
+          EXPECT_TRUE (std::isnan (points[i + offset].data[k]));
+          EXPECT_TRUE (std::isnan (c1.data[k]));
+          EXPECT_TRUE (std::isnan (c2.data[k]));
+        }
+        else
+        {
+          EXPECT_EQ (expected[i].data[k], points[i + offset].data[k]);
+          EXPECT_EQ (expected[i].data[k], c1.data[k]);
+          EXPECT_EQ (expected[i].data[k], c2.data[k]);
+        }
+      }
+    }
+  }
+}
+
+TEST (RayTableTest, DepthRange)
+{
+  // Odd size so that both vectorized and scalar code paths are covered
+  const size_t width = 7;
+  const size_t height = 3;
+  RayTable table (width, height, createIntrinsics ());
+  table.setDepthRange (300, 900);
+  std::vector<unsigned short> depth (width * height);
+  for (size_t i = 0; i < depth.size (); ++i)
+    depth[i] = i * 50;
+  std::vector<Point> points (depth.size ());
+  table.project (depth.data (), points.data ());
+  for (size_t i = 0; i < depth.size (); ++i)
+  {
+    if (depth[i] < 300 || depth[i] > 900)
+      EXPECT_TRUE (std::isnan (points[i].data[2])) << depth[i];
+    else
+      EXPECT_FLOAT_EQ (depth[i] * 0.001f, points[i].data[2]);
+  }
+
+  // Zero depth stays invalid even if the range starts at zero
+  table.setDepthRange (0, 900);
+  EXPECT_EQ (1, table.getMinDepth ());
+  table.project (depth.data (), points.data ());
+  EXPECT_TRUE (std::isnan (points[0].data[2]));
+  EXPECT_FLOAT_EQ (0.05f, points[1].data[2]);
+}
+
+int main (int argc, char **argv)
+{
+  testing::InitGoogleTest (&argc, argv);
+  return RUN_ALL_TESTS ();
+}
@@ -0,0 +1,95 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <stdexcept>
+
+#include <boost/atomic.hpp>
+
+#include "thread_pool.h"
+
+using namespace pcl::io;
+
+struct Fill
+{
+  Fill (std::vector<int>* data) : data (data) { }
+  void operator() (size_t begin, size_t end) { for (size_t i = begin; i < end; ++i) (*data)[i] = 1; }
+  std::vector<int>* data;
+};
+
+TEST (ThreadPoolTest, ProcessesAllTiles)
+{
+  ThreadPool pool (4);
+  std::vector<int> data (1000, 0);
+  pool.parallelFor (0, data.size (), 7, Fill (&data));
+  for (size_t i = 0; i < data.size (); ++i)
+    ASSERT_EQ (1, data[i]);
+}
+
+struct Throw
+{
+  Throw (boost::atomic<int>* num_calls) : num_calls (num_calls) { }
+  void operator() (size_t begin, size_t)
+  {
+    ++*num_calls;
+    if (begin == 40)
+      throw std::runtime_error ("tile failed");
+  }
+  boost::atomic<int>* num_calls;
+};
+
+TEST (ThreadPoolTest, RethrowsExceptionInCaller)
+{
+  ThreadPool pool (4);
+  boost::atomic<int> num_calls (0);
+  // Used to deadlock because the failed tile was never counted as done
+  EXPECT_THROW (pool.parallelFor (0, 1000, 10, Throw (&num_calls)), std::runtime_error);
+  EXPECT_LE (num_calls.load (), 100);
+  // Pool is still usable afterwards
+  std::vector<int> data (100, 0);
+  pool.parallelFor (0, data.size (), 10, Fill (&data));
+  for (size_t i = 0; i < data.size (); ++i)
+    ASSERT_EQ (1, data[i]);
+}
+
+int main (int argc, char **argv)
+{
+  testing::InitGoogleTest (&argc, argv);
+  return RUN_ALL_TESTS ();
+}
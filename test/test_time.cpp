@@ -0,0 +1,223 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <string>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/barrier.hpp>
+
+#include "real_sense/time.h"
+
+using namespace pcl::io::real_sense;
+
+/* Records of the calling thread with the given title. */
+std::vector<ScopeTimeRecord>
+getRecords (const char* title)
+{
+  std::vector<ScopeTimeRecord> all;
+  ScopeTimeLog::getCurrent ().getRecords (all);
+  std::vector<ScopeTimeRecord> records;
+  for (size_t i = 0; i < all.size (); ++i)
+    if (std::string (all[i].title) == title)
+      records.push_back (all[i]);
+  return (records);
+}
+
+TEST (TimeTest, MonotonicClock)
+{
+  boost::uint64_t previous = getMonotonicTimeNs ();
+  for (int i = 0; i < 1000; ++i)
+  {
+    boost::uint64_t now = getMonotonicTimeNs ();
+    ASSERT_GE (now, previous);
+    previous = now;
+  }
+}
+
+TEST (TimeTest, StopWatchResolution)
+{
+  pcl::MyStopWatch watch;
+  boost::this_thread::sleep_for (boost::chrono::microseconds (1500));
+  // Used to be truncated to whole milliseconds
+  double ms = watch.getTime ();
+  EXPECT_GE (ms, 1.5);
+  EXPECT_NE (ms, static_cast<int> (ms));
+  EXPECT_NEAR (watch.getTimeMicroSeconds () * 1.0e-3, watch.getTime (), 1.0);
+  watch.reset ();
+  EXPECT_LT (watch.getTime (), 1.5);
+}
+
+TEST (TimeTest, ScopeTimeRecordsIntoThreadLog)
+{
+  const size_t before = getRecords ("scope").size ();
+  const boost::uint64_t start = getMonotonicTimeNs ();
+  {
+    pcl::MyScopeTime timer ("scope");
+    boost::this_thread::sleep_for (boost::chrono::milliseconds (1));
+  }
+  std::vector<ScopeTimeRecord> records = getRecords ("scope");
+  ASSERT_EQ (before + 1, records.size ());
+  EXPECT_GE (records.back ().start, start);
+  EXPECT_GE (records.back ().duration, 1000000);
+}
+
+TEST (TimeTest, LogKeepsMostRecentRecords)
+{
+  ScopeTimeLog log (0);
+  for (size_t i = 0; i < SCOPE_TIME_LOG_CAPACITY + 10; ++i)
+    log.record ("x", i, 1);
+  std::vector<ScopeTimeRecord> records;
+  log.getRecords (records);
+  ASSERT_EQ (SCOPE_TIME_LOG_CAPACITY, records.size ());
+  EXPECT_EQ (10, records.front ().start);
+  EXPECT_EQ (SCOPE_TIME_LOG_CAPACITY + 9, records.back ().start);
+  EXPECT_EQ (SCOPE_TIME_LOG_CAPACITY + 10, log.getNumRecorded ());
+}
+
+void
+recordScopes (int count, boost::barrier* barrier)
+{
+  for (int i = 0; i < count; ++i)
+    pcl::MyScopeTime timer ("worker");
+  // Keep threads alive until all of them have their own log
+  if (barrier)
+    barrier->wait ();
+}
+
+TEST (TimeTest, LogsOutliveThreads)
+{
+  boost::barrier barrier (2);
+  boost::thread worker1 (boost::bind (&recordScopes, 10, &barrier));
+  boost::thread worker2 (boost::bind (&recordScopes, 20, &barrier));
+  worker1.join ();
+  worker2.join ();
+  std::vector<ScopeTimeLog::Ptr> logs = ScopeTimeLog::getAll ();
+  std::set<size_t> counts;
+  std::set<size_t> thread_indices;
+  for (size_t i = 0; i < logs.size (); ++i)
+  {
+    std::vector<ScopeTimeRecord> records;
+    logs[i]->getRecords (records);
+    if (!records.empty () && std::string (records[0].title) == "worker")
+      counts.insert (records.size ());
+    thread_indices.insert (logs[i]->getThreadIndex ());
+  }
+  EXPECT_EQ (1, counts.count (10));
+  EXPECT_EQ (1, counts.count (20));
+  EXPECT_EQ (logs.size (), thread_indices.size ());
+}
+
+TEST (TimeTest, LogsOfFinishedThreadsAreReused)
+{
+  // Make sure that there are free logs to begin with
+  {
+    boost::barrier barrier (2);
+    boost::thread worker1 (boost::bind (&recordScopes, 1, &barrier));
+    boost::thread worker2 (boost::bind (&recordScopes, 1, &barrier));
+    worker1.join ();
+    worker2.join ();
+  }
+  const size_t num_logs = ScopeTimeLog::getAll ().size ();
+  for (int i = 0; i < 100; ++i)
+  {
+    boost::barrier barrier (2);
+    boost::thread worker1 (boost::bind (&recordScopes, 1, &barrier));
+    boost::thread worker2 (boost::bind (&recordScopes, 1, &barrier));
+    worker1.join ();
+    worker2.join ();
+    ASSERT_EQ (num_logs, ScopeTimeLog::getAll ().size ());
+  }
+}
+
+void
+checkLogIsEmpty (bool* empty)
+{
+  std::vector<ScopeTimeRecord> records;
+  ScopeTimeLog::getCurrent ().getRecords (records);
+  *empty = records.empty ();
+}
+
+TEST (TimeTest, ReusedLogsStartEmpty)
+{
+  boost::thread worker (boost::bind (&recordScopes, 10, static_cast<boost::barrier*> (0)));
+  worker.join ();
+  const size_t num_logs = ScopeTimeLog::getAll ().size ();
+  bool empty = false;
+  boost::thread checker (boost::bind (&checkLogIsEmpty, &empty));
+  checker.join ();
+  ASSERT_EQ (num_logs, ScopeTimeLog::getAll ().size ());
+  EXPECT_TRUE (empty);
+}
+
+/* The owner overwrites records with start == duration while readers copy
+ * them. Readers must never see a torn record. */
+void
+poll (const ScopeTimeLog* log, boost::atomic<bool>* done, bool* consistent)
+{
+  std::vector<ScopeTimeRecord> records;
+  while (!done->load ())
+  {
+    records.clear ();
+    log->getRecords (records);
+    for (size_t i = 0; i < records.size (); ++i)
+      if (records[i].start != records[i].duration)
+        *consistent = false;
+  }
+}
+
+TEST (TimeTest, ConcurrentReaders)
+{
+  ScopeTimeLog log (0);
+  boost::atomic<bool> done (false);
+  bool consistent = true;
+  boost::thread reader (boost::bind (&poll, &log, &done, &consistent));
+  for (boost::uint64_t i = 0; i < 20 * SCOPE_TIME_LOG_CAPACITY; ++i)
+    log.record ("x", i, i);
+  done = true;
+  reader.join ();
+  EXPECT_TRUE (consistent);
+}
+
+int main (int argc, char **argv)
+{
+  testing::InitGoogleTest (&argc, argv);
+  return RUN_ALL_TESTS ();
+}
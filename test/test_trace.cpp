@@ -0,0 +1,137 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2014-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+
+#include <boost/thread/thread.hpp>
+
+#include "real_sense/trace.h"
+
+using namespace pcl::io::real_sense;
+
+/* Number of scopes with the given title in the log of the calling thread. */
+size_t
+countRecords (const char* title)
+{
+  std::vector<ScopeTimeRecord> records;
+  ScopeTimeLog::getCurrent ().getRecords (records);
+  size_t count = 0;
+  for (size_t i = 0; i < records.size (); ++i)
+    if (std::string (records[i].title) == title)
+      ++count;
+  return (count);
+}
+
+void
+traced ()
+{
+  PCL_REAL_SENSE_TRACE_SCOPE ("traced");
+}
+
+TEST (TraceTest, DisabledByDefault)
+{
+  EXPECT_FALSE (isTracingEnabled ());
+  traced ();
+  EXPECT_EQ (0, countRecords ("traced"));
+}
+
+TEST (TraceTest, RecordsScopesWhenEnabled)
+{
+  setTracingEnabled (true);
+  traced ();
+  {
+    PCL_REAL_SENSE_TRACE_SCOPE ("outer");
+    PCL_REAL_SENSE_TRACE_SCOPE ("inner");
+  }
+  setTracingEnabled (false);
+  traced ();
+  EXPECT_EQ (1, countRecords ("traced"));
+  EXPECT_EQ (1, countRecords ("outer"));
+  EXPECT_EQ (1, countRecords ("inner"));
+}
+
+void
+untracedWorker ()
+{
+  setTraceThreadName ("untraced worker");
+  traced ();
+}
+
+TEST (TraceTest, NamingThreadsDoesNotCreateLogs)
+{
+  const size_t num_logs = ScopeTimeLog::getAll ().size ();
+  for (int i = 0; i < 10; ++i)
+  {
+    boost::thread thread (&untracedWorker);
+    thread.join ();
+  }
+  EXPECT_EQ (num_logs, ScopeTimeLog::getAll ().size ());
+}
+
+void
+worker ()
+{
+  setTraceThreadName ("worker \"1\"");
+  PCL_REAL_SENSE_TRACE_SCOPE ("work");
+}
+
+TEST (TraceTest, ChromeTrace)
+{
+  setTracingEnabled (true);
+  boost::thread thread (&worker);
+  thread.join ();
+  setTracingEnabled (false);
+
+  std::stringstream ss;
+  writeChromeTrace (ss);
+  const std::string trace = ss.str ();
+  EXPECT_EQ (0, trace.find ("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+  EXPECT_NE (std::string::npos, trace.find ("\"args\":{\"name\":\"worker \\\"1\\\"\"}"));
+  EXPECT_NE (std::string::npos, trace.find ("{\"ph\":\"X\",\"name\":\"work\",\"pid\":1,\"tid\":"));
+  EXPECT_EQ (trace.size () - 4, trace.rfind ("\n]}\n"));
+  // Earliest scope is at time zero
+  EXPECT_NE (std::string::npos, trace.find ("\"ts\":0.000,"));
+}
+
+int main (int argc, char **argv)
+{
+  testing::InitGoogleTest (&argc, argv);
+  return RUN_ALL_TESTS ();
+}